@@ -0,0 +1,115 @@
+/*
+ * space invaders game - autosave
+ *
+ * saves the game every so many ticks without holding up the tick loop:
+ * between two ticks the state is copied out (sim_state_t::capture), the
+ * snapshot is made and written on the file writer's thread. how long
+ * the copy took, and whether it pushed its tick over budget, goes into
+ * the stats along with how long the background part took.
+ *
+ * there are two captures, used in turn: the tick fills the one the
+ * writer isn't reading and the writer turns the newest one into a
+ * snapshot. once their vectors have grown to the game's size nothing
+ * is allocated for an autosave.
+ */
+
+#ifndef INVADERS_AUTOSAVE_H
+#define INVADERS_AUTOSAVE_H
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+
+#include "sim.h"
+#include "stats.h"
+#include "writer.h"
+
+class autosave_t {
+	file_writer_t& writer;
+	stats_t& stats;
+	std::string path;
+
+	/* ticks between autosaves (0 is off) and since the last one */
+	unsigned long every, since;
+
+	/* how long a tick plus the copy may take */
+	uint64_t budget_ns;
+
+	sim_capture_t captures[2];
+
+	/*
+	 * the newest filled capture and the one the writer is reading (-1
+	 * if none). the lock only covers these two, not the copies.
+	 */
+	std::mutex m;
+	int latest, reading;
+
+	/* capture the tick can fill (not the newest), -1 if the writer is still reading that one */
+	int free_capture() {
+		std::lock_guard<std::mutex> l(m);
+		int c = latest < 0 ? 0 : 1 - latest;
+		return c == reading ? -1 : c;
+	}
+
+	/* on the writer thread, snapshot of the newest capture */
+	void marshal_latest(std::vector<uint8_t>& buf) {
+		{
+			std::lock_guard<std::mutex> l(m);
+			reading = latest;
+		}
+
+		captures[reading].marshal(buf);
+
+		std::lock_guard<std::mutex> l(m);
+		reading = -1;
+	}
+
+public:
+	void set_interval(unsigned long ticks) {
+		every = ticks;
+		since = 0;
+	}
+
+	/*
+	 * call after every tick, tick_ns is how long it took. saves if it's
+	 * time and the game is being played.
+	 */
+	void after_tick(sim_t& sim, uint64_t tick_ns) {
+		if (!every || ++since < every || !(sim.get_state() & STATE_PLAYING))
+			return;
+
+		/* writer's behind, try again next tick */
+		int c = free_capture();
+		if (c < 0)
+			return;
+
+		since = 0;
+
+		auto t0 = stats_clock::now();
+		sim.capture(captures[c]);
+		uint64_t ns = stats_ns(stats_clock::now() - t0);
+
+		{
+			std::lock_guard<std::mutex> l(m);
+			latest = c;
+		}
+
+		stats.on_autosave_capture(ns, tick_ns + ns > budget_ns);
+
+		/* a job that gets replaced by a newer one for the same file is fine, whichever runs writes the newest */
+		stats_t* st = &stats;
+		writer.submit(path.c_str(),
+					  [this](std::vector<uint8_t>& buf) { marshal_latest(buf); },
+					  [st](bool ok, uint64_t ns) { st->on_autosave_write(ns, ok); });
+	}
+
+	autosave_t(file_writer_t& w, stats_t& s, const char* p, uint64_t tick_budget_ns) :
+		writer(w), stats(s), path(p), every(0), since(0), budget_ns(tick_budget_ns), latest(-1), reading(-1) {}
+
+	/* the writer's jobs read the captures */
+	~autosave_t() {
+		writer.drain();
+	}
+};
+
+#endif /* INVADERS_AUTOSAVE_H */
@@ -0,0 +1,170 @@
+/*
+ * space invaders game - asset baker
+ *
+ * decodes every sprite scene_t::load_textures() wants, builds its mip
+ * chain and writes the lot into one pack file (format in pack.h) that
+ * the game maps at startup instead of decoding and resampling images
+ * on every launch. rerun it whenever images/ changes.
+ *
+ *   usage: invaders-bake [-o images/sprites.pack]
+ *
+ * run it from the directory that has images/ in it, like the game.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "render.h"
+#include "pack.h"
+
+/***************************************************************
+ * MIP CHAIN
+ ***************************************************************/
+
+/*
+ * next level down: every pixel is the average of the 2x2 block above
+ * it (an edge row or column just repeats). the pixels are premultiplied
+ * so a plain average is the right thing to do.
+ */
+static void half_level(const image_t& src, image_t& dst) {
+	dst.w = std::max(src.w / 2, 1);
+	dst.h = std::max(src.h / 2, 1);
+	dst.px.resize(dst.w * dst.h);
+
+	for (int y = 0; y < dst.h; y++) {
+		const uint32_t* r0 = &src.px[std::min(y * 2, src.h - 1) * src.w];
+		const uint32_t* r1 = &src.px[std::min(y * 2 + 1, src.h - 1) * src.w];
+
+		for (int x = 0; x < dst.w; x++) {
+			int x0 = std::min(x * 2, src.w - 1), x1 = std::min(x * 2 + 1, src.w - 1);
+			uint32_t out = 0;
+
+			for (int sh = 0; sh < 32; sh += 8) {
+				unsigned c = ((r0[x0] >> sh) & 0xff) + ((r0[x1] >> sh) & 0xff) +
+							 ((r1[x0] >> sh) & 0xff) + ((r1[x1] >> sh) & 0xff);
+				out |= ((c + 2) / 4) << sh;
+			}
+
+			dst.px[y * dst.w + x] = out;
+		}
+	}
+}
+
+/* every level down to 1x1 */
+static void build_mips(const image_t& img, std::vector<image_t>& levels) {
+	levels.assign(1, img);
+
+	while (levels.back().w > 1 || levels.back().h > 1) {
+		image_t next;
+		half_level(levels.back(), next);
+		levels.push_back(next);
+	}
+}
+
+/***************************************************************
+ * BAKER
+ ***************************************************************/
+
+int main(int argc, const char * argv[])
+{
+	const char* out_path = ASSET_PACK_FILE;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-o") && i+1 < argc)
+			out_path = argv[++i];
+		else {
+			fprintf(stderr, "usage: %s [-o pack]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const char* paths[_kTexEnd];
+	scene_t::sprite_paths(paths);
+
+	image_t imgs[_kTexEnd];
+	load_images(paths, _kTexEnd, imgs);
+
+	/* lay the file out first so it can go out in one write */
+	std::vector<pack_entry_t> index;
+	std::vector<std::vector<image_t> > chains;
+
+	for (int k = 0; k < _kTexEnd; k++) {
+		if (!paths[k])
+			continue;
+
+		if (!imgs[k].w) {
+			fprintf(stderr, "can't load %s\n", paths[k]);
+			return 1;
+		}
+
+		std::vector<image_t> chain;
+		build_mips(imgs[k], chain);
+
+		if (chain.size() > PACK_MAX_LEVELS) {
+			fprintf(stderr, "%s is too big (%dx%d)\n", paths[k], imgs[k].w, imgs[k].h);
+			return 1;
+		}
+
+		pack_entry_t e;
+		memset(&e, 0, sizeof(e));
+		e.id = k;
+		e.w = imgs[k].w;
+		e.h = imgs[k].h;
+		e.levels = static_cast<uint32_t>(chain.size());
+
+		index.push_back(e);
+		chains.push_back(chain);
+	}
+
+	uint64_t off = pack_align(sizeof(pack_header_t) + index.size() * sizeof(pack_entry_t));
+
+	for (size_t i = 0; i < index.size(); i++) {
+		for (size_t l = 0; l < chains[i].size(); l++) {
+			index[i].off[l] = off;
+			off = pack_align(off + chains[i][l].px.size() * 4);
+		}
+	}
+
+	std::vector<uint8_t> file(off, 0);
+
+	pack_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PACK_MAGIC, 4);
+	header.version = PACK_VERSION;
+	header.count = static_cast<uint32_t>(index.size());
+	header.size = off;
+
+	memcpy(&file[0], &header, sizeof(header));
+	memcpy(&file[sizeof(header)], index.data(), index.size() * sizeof(pack_entry_t));
+
+	for (size_t i = 0; i < index.size(); i++) {
+		for (size_t l = 0; l < chains[i].size(); l++)
+			memcpy(&file[index[i].off[l]], chains[i][l].px.data(), chains[i][l].px.size() * 4);
+
+		printf("%-28s %4ux%-4u %u levels\n", paths[index[i].id], index[i].w, index[i].h, index[i].levels);
+	}
+
+	/* write next to it and rename, a running game never maps half a pack */
+	std::string tmp = std::string(out_path) + ".tmp";
+	FILE* f = fopen(tmp.c_str(), "wb");
+	if (!f) {
+		perror(tmp.c_str());
+		return 1;
+	}
+
+	bool ok = fwrite(file.data(), 1, file.size(), f) == file.size();
+	ok = (fclose(f) == 0) && ok;
+
+	if (!ok || rename(tmp.c_str(), out_path) != 0) {
+		perror(out_path);
+		remove(tmp.c_str());
+		return 1;
+	}
+
+	printf("%s: %zu sprites, %llu bytes\n", out_path, index.size(), (unsigned long long)off);
+	return 0;
+}
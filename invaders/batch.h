@@ -0,0 +1,204 @@
+/*
+ * space invaders game - batched environments
+ *
+ * a lot of independent games stepped together, for training bots:
+ * reset(seeds) starts every game, step(actions) steps every game once
+ * and fills in rewards, done flags and observations. all buffers are
+ * the caller's, one contiguous array each indexed by game, and nothing
+ * is allocated after construction, so a training loop can call step()
+ * millions of times.
+ *
+ * the games are bot_state_t, small enough to keep thousands of them.
+ * they're cut into contiguous chunks which are spread over a
+ * worker pool. each game only ever touches its own state, so the
+ * results don't depend on how many threads there are or which one
+ * stepped what. no GL or GLUT, this only needs sim.h.
+ *
+ * observations are the feature vector (bot_state_t::observe) and, after
+ * set_pixels(), a stack of the last few low resolution frames per game
+ * (obs.h) as well. either can be left out of a call by passing NULL.
+ */
+
+#ifndef INVADERS_BATCH_H
+#define INVADERS_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "sim.h"
+#include "pool.h"
+#include "obs.h"
+
+/* playfield the batched games run on, same as the game window */
+#define BATCH_SURFACE_W 600
+#define BATCH_SURFACE_H 500
+
+/* reward for losing a life, on top of the points a step scored */
+#define BATCH_HIT_PENALTY 100.0f
+
+/* chunks per pool thread, a few so a slow chunk doesn't hold up the rest */
+#define BATCH_CHUNKS_PER_THREAD 4
+
+class batch_env_t {
+	std::vector<bot_state_t> envs;
+	worker_pool_t pool;
+	size_t chunks;
+
+	/* the jobs are made once, they read the current call's buffers from here */
+	std::function<void(size_t)> reset_job, step_job;
+	const uint64_t* seeds;
+	const uint8_t* actions;
+	float* rewards;
+	uint8_t* dones;
+	float* obs;
+	uint8_t* pixels;
+
+	/* frames per game, empty until set_pixels() */
+	obs_raster_t raster;
+	std::vector<obs_stack_t> stacks;
+
+	/* game i's stacked frames into pixels, restart if it's a new game */
+	void write_pixels(size_t i, bool restart) {
+		if (!pixels || stacks.empty())
+			return;
+
+		if (restart)
+			stacks[i].restart(raster, envs[i]);
+		else
+			stacks[i].push(raster, envs[i]);
+
+		stacks[i].read(pixels + i * stacks[i].size());
+	}
+
+	size_t chunk_begin(size_t c) {
+		return c * envs.size() / chunks;
+	}
+
+	void reset_chunk(size_t c) {
+		for (size_t i = chunk_begin(c), e = chunk_begin(c+1); i < e; i++) {
+			bot_state_t& s = envs[i];
+
+			s.seed(seeds[i]);
+			s.init(BATCH_SURFACE_W, BATCH_SURFACE_H);
+			s.reset_if_possible();
+
+			if (obs)
+				s.observe(obs + i * OBS_FEATURES);
+			write_pixels(i, true);
+		}
+	}
+
+	void step_chunk(size_t c) {
+		for (size_t i = chunk_begin(c), e = chunk_begin(c+1); i < e; i++) {
+			bot_state_t& s = envs[i];
+
+			int lives = s.get_lives();
+			int points = ::step(s, actions[i]);
+			rewards[i] = points - hit_penalty * (lives - s.get_lives());
+
+			/* round over, carry on with the next one like the enter key does */
+			bool done = !(s.get_state() & STATE_PLAYING);
+			dones[i] = done;
+			if (done)
+				s.reset_if_possible();
+
+			if (obs)
+				s.observe(obs + i * OBS_FEATURES);
+			write_pixels(i, done);
+		}
+	}
+
+public:
+	/* subtracted from a step's reward per life it lost */
+	float hit_penalty;
+
+	/*
+	 * n games, stepped on the caller's thread plus threads extra ones
+	 * (by default one less than there are cores)
+	 */
+	explicit batch_env_t(size_t n, unsigned threads = ~0u) :
+		envs(n), pool(threads), seeds(NULL), actions(NULL), rewards(NULL),
+		dones(NULL), obs(NULL), pixels(NULL),
+		raster(BATCH_SURFACE_W, BATCH_SURFACE_H, false), hit_penalty(BATCH_HIT_PENALTY) {
+		chunks = std::max<size_t>(1, std::min(n, pool.size() * BATCH_CHUNKS_PER_THREAD));
+
+		reset_job = [this](size_t c) { reset_chunk(c); };
+		step_job = [this](size_t c) { step_chunk(c); };
+	}
+
+	size_t size() {
+		return envs.size();
+	}
+
+	/* threads stepping the games, the caller's included */
+	size_t threads() {
+		return pool.size();
+	}
+
+	/*
+	 * turn on pixel observations: a stack of each game's last few frames
+	 * (frames of them), gray or with a plane per layer. takes effect from
+	 * the next reset(). false if frames is 0, nothing changes then.
+	 */
+	bool set_pixels(size_t frames, bool layers) {
+		if (frames < 1)
+			return false;
+
+		raster = obs_raster_t(BATCH_SURFACE_W, BATCH_SURFACE_H, layers);
+		stacks.assign(envs.size(), obs_stack_t(raster.frame_size(), frames));
+		return true;
+	}
+
+	/* bytes of pixels per game, 0 if they're off */
+	size_t pixels_size() {
+		return stacks.empty() ? 0 : stacks[0].size();
+	}
+
+	/* game i, to look at or to clone */
+	bot_state_t& operator[](size_t i) {
+		return envs[i];
+	}
+
+	/*
+	 * start a new game in every slot, game i seeded with seed[i], and
+	 * write the first observations (size() * OBS_FEATURES floats) if
+	 * observations isn't NULL. frames (size() * pixels_size() bytes) get
+	 * the first frame in every slot of the stack. false if the levels
+	 * don't fit a bot_state_t (see sim_limits_t), nothing's set up then.
+	 */
+	bool reset(const uint64_t* seed, float* observations, uint8_t* frames = NULL) {
+		if (!bot_state_t::levels_fit())
+			return false;
+
+		seeds = seed;
+		obs = observations;
+		pixels = frames;
+		pool.run(chunks, reset_job);
+		return true;
+	}
+
+	/*
+	 * step every game once with action[i] (sim_action_t bits). reward[i]
+	 * gets the points scored less hit_penalty per life lost, done[i] is
+	 * set if the round ended. a game whose round ended goes straight on
+	 * to the next round (or the next level after a win) so every slot is
+	 * always playing, and the observation written is of the new round
+	 * (its frame stack starts over too).
+	 *
+	 * frames only stay stacked if every step writes them, a step without
+	 * them doesn't draw.
+	 */
+	void step(const uint8_t* action, float* reward, uint8_t* done, float* observations, uint8_t* frames = NULL) {
+		actions = action;
+		rewards = reward;
+		dones = done;
+		obs = observations;
+		pixels = frames;
+		pool.run(chunks, step_job);
+	}
+};
+
+#endif /* INVADERS_BATCH_H */
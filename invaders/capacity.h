@@ -0,0 +1,26 @@
+/*
+ * space invaders game - capacity
+ *
+ * the most a game can hold. the sim keeps everything in fixed arrays
+ * of these sizes (see sim_limits_t in sim.h) and a snapshot can't hold
+ * more than the game does, so both take their limits from here.
+ *
+ * the grid goes far past what the levels in gDifficultyLevels use (8
+ * columns of 3 rows), the grid and hit tests are built to scale to a
+ * few thousand aliens, and the shot pool has room for a bullet hell.
+ */
+
+#ifndef INVADERS_CAPACITY_H
+#define INVADERS_CAPACITY_H
+
+#define GRID_MAX_COLS 256
+#define GRID_MAX_ROWS 16
+#define GRID_MAX_ALIENS (GRID_MAX_COLS * GRID_MAX_ROWS)
+
+/* a fire and a cloak event per grid alien */
+#define SCHED_MAX_EVENTS (2 * GRID_MAX_ALIENS)
+
+/* enemy shots in flight */
+#define PROJ_POOL_SIZE 4096
+
+#endif /* INVADERS_CAPACITY_H */
@@ -0,0 +1,671 @@
+/*
+ * space invaders game - headless driver
+ *
+ * steps the simulation core as fast as the CPU allows with no window,
+ * GL or GLUT involved, so the game logic can run (and be timed) on boxes
+ * without a display. a dumb autopilot plays so rounds actually progress.
+ *
+ *   usage: invaders-headless [-t ticks] [-s seed] [-l] [-r] [-p] [-o frame.ppm] [-a ticks] [-w replay [-k ticks]]
+ *          invaders-headless -replay file [-seek tick]
+ *          invaders-headless -b [-s seed]
+ *          invaders-headless -e games [-t steps] [-j threads] [-s seed] [-x frames [-c]]
+ *          invaders-headless -check
+ *
+ * -l times every tick and prints the latency histogram, which costs a
+ * couple of clock reads per tick so it's off by default. -r draws a
+ * frame after every tick with the software renderer and reports how
+ * long that took, -p only repaints what each tick changed instead of
+ * the whole frame, -o writes the last frame out (implies -r). -a
+ * autosaves to autosave.bin every that many ticks, like the game does,
+ * and reports what that cost. -w records the autopilot's inputs, with
+ * a keyframe every -k ticks.
+ *
+ * -replay runs a recording (the game's -record, or -w) as fast as it
+ * goes and checks it ends in exactly the recorded state, exits 1 if
+ * it doesn't. with -seek it jumps to that tick instead and reports how
+ * long that took.
+ *
+ * -b times what a lookahead bot does with the sim: cloning a game,
+ * stepping it and a small search (every action, a few steps deep).
+ *
+ * -e steps that many games at once through the batch api with random
+ * actions, -t times over, once on one thread and once on -j extra
+ * threads (default all the cores), and checks both ran the same games.
+ * -x adds pixel observations, stacks of that many gray frames, or a
+ * plane per layer with -c. with -o the last stack of the first game is
+ * written out.
+ *
+ * -check feeds the loaders and the batch api input they have to turn
+ * down (snapshots that are damaged in ways the checksum can't see, a
+ * stack of no frames) and exits 1 if any of it gets through.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "sim.h"
+#include "render.h"
+#include "softrender.h"
+#include "stats.h"
+#include "writer.h"
+#include "autosave.h"
+#include "replay.h"
+#include "batch.h"
+
+#define AUTOSAVE_FILE "autosave.bin"
+
+/* the game's TICK_MS */
+#define TICK_BUDGET_NS 2000000
+
+/***************************************************************
+ * HEADLESS DRIVER
+ ***************************************************************/
+
+/*
+ * sweeps left and right, fires whenever it can and presses enter
+ * when a round is over.
+ */
+class autopilot_t {
+	int sweep;
+
+public:
+	unsigned long rounds_won, rounds_lost;
+
+	/* where the key presses go, if anywhere */
+	replay_recorder_t* recorder;
+
+	void step(sim_t& sim, unsigned long t) {
+		int st = sim.get_state();
+
+		if (!(st & STATE_PLAYING)) {
+			if (st & STATE_WON) rounds_won++;
+			if (st & STATE_LOST) rounds_lost++;
+			if (sim.reset_if_possible() && recorder)
+				recorder->record(sim, kInputEnter, 0);
+			return;
+		}
+
+		/* change direction every 100 ticks */
+		if (t % 100 == 0) {
+			sweep = -sweep;
+			sim.set_player_delta(sweep);
+			if (recorder)
+				recorder->record(sim, kInputDelta, sweep);
+		}
+
+		if (sim.player_fire_if_ready() && recorder)
+			recorder->record(sim, kInputFire, 0);
+	}
+
+	autopilot_t() : sweep(4), rounds_won(0), rounds_lost(0), recorder(NULL) {}
+};
+
+/*
+ * -b: clone/step throughput, on a game the autopilot has been playing
+ * for a while so there's a grid, shots and specials to copy. the game
+ * is moved into a bot_state_t through a snapshot, that's the size bots
+ * clone.
+ */
+#define BENCH_CLONES 1000000
+#define BENCH_STEPS 1000000
+#define BENCH_DECISIONS 2000
+#define BENCH_DEPTH 32
+
+static int run_bench(uint64_t seed) {
+	sim_t sim;
+	autopilot_t pilot;
+
+	sim.seed(seed);
+	if (!sim.init(600, 500))
+		return 1;
+
+	for (unsigned long t = 0; t < 3000; t++) {
+		pilot.step(sim, t);
+		sim.tick();
+	}
+
+	std::vector<uint8_t> snap;
+	sim.marshal(snap);
+
+	bot_state_t base;
+	if (!base.init(600, 500) || !base.unmarshal(snap.data(), snap.size()) || base.digest() != sim.digest()) {
+		fprintf(stderr, "the game doesn't fit in a bot_state_t\n");
+		return 1;
+	}
+
+	std::vector<bot_state_t> clones(64);
+	rng_t rng;
+	rng.seed(seed);
+	long sink = 0;
+
+	printf("sim state: %zu bytes, bot state: %zu bytes\n", sizeof(sim_state_t), sizeof(bot_state_t));
+
+	/* clone into a ring of slots, so it's a real copy every time */
+	auto t0 = stats_clock::now();
+	for (int i = 0; i < BENCH_CLONES; i++)
+		clones[i & 63] = base;
+	double clone_ns = stats_ns(stats_clock::now() - t0) / (double)BENCH_CLONES;
+
+	for (auto& c : clones)
+		sink += c.get_points();
+
+	/* random play, starting over from base when the round ends */
+	bot_state_t s = base;
+	t0 = stats_clock::now();
+	for (int i = 0; i < BENCH_STEPS; i++) {
+		if (!(s.get_state() & STATE_PLAYING))
+			s = base;
+		sink += step(s, rng.below(_kActEnd));
+	}
+	double step_ns = stats_ns(stats_clock::now() - t0) / (double)BENCH_STEPS;
+
+	/* every action from the same state, BENCH_DEPTH random steps after it */
+	t0 = stats_clock::now();
+	for (int d = 0; d < BENCH_DECISIONS; d++) {
+		for (int a = 0; a < _kActEnd; a++) {
+			s = base;
+			sink += step(s, a);
+			for (int k = 1; k < BENCH_DEPTH; k++)
+				sink += step(s, rng.below(_kActEnd));
+		}
+	}
+	double decision_ns = stats_ns(stats_clock::now() - t0) / (double)BENCH_DECISIONS;
+
+	printf("clone: %.0f ns (%.0f/s)\n", clone_ns, 1e9 / clone_ns);
+	printf("step: %.0f ns (%.0f/s)\n", step_ns, 1e9 / step_ns);
+	printf("lookahead, %d actions x %d steps: %.1f us per decision (%.0f/s)\n",
+		   _kActEnd, BENCH_DEPTH, decision_ns / 1e3, 1e9 / decision_ns);
+
+	/* keeps the work from being optimized out */
+	return sink == 42 ? 2 : 0;
+}
+
+/*
+ * -e: batched steps per second. the actions are drawn ahead of time
+ * so only the steps are timed. digest gets a hash of where every game
+ * ended up and its last observation. false if the games can't start.
+ */
+static bool batch_run(batch_env_t& env, uint64_t seed, unsigned long steps, double* secs, double* reward,
+					  std::vector<uint8_t>& pixels, uint64_t* digest) {
+	size_t n = env.size();
+	std::vector<uint64_t> seeds(n);
+	std::vector<uint8_t> actions(n), dones(n);
+	std::vector<float> rewards(n), obs(n * OBS_FEATURES);
+	pixels.resize(n * env.pixels_size());
+
+	uint8_t* px = pixels.empty() ? NULL : pixels.data();
+
+	for (size_t i = 0; i < n; i++)
+		seeds[i] = seed + i;
+
+	if (!env.reset(seeds.data(), obs.data(), px))
+		return false;
+
+	rng_t rng;
+	rng.seed(seed);
+	*secs = 0;
+	*reward = 0;
+
+	for (unsigned long t = 0; t < steps; t++) {
+		for (size_t i = 0; i < n; i++)
+			actions[i] = static_cast<uint8_t>(rng.below(_kActEnd));
+
+		auto t0 = stats_clock::now();
+		env.step(actions.data(), rewards.data(), dones.data(), obs.data(), px);
+		*secs += stats_ns(stats_clock::now() - t0) / 1e9;
+
+		for (size_t i = 0; i < n; i++)
+			*reward += rewards[i];
+	}
+
+	state_hash_t h;
+	for (size_t i = 0; i < n; i++)
+		h.add(env[i].digest());
+	h.add(obs.data(), obs.size() * sizeof(float));
+	h.add(pixels.data(), pixels.size());
+	*digest = h.value();
+	return true;
+}
+
+/* 1 if the threaded run ended up anywhere the single threaded one didn't */
+static int run_batch(uint64_t seed, size_t games, unsigned long steps, unsigned threads,
+					 size_t frames, bool layers, const char* frames_out) {
+	uint64_t digests[2];
+	unsigned pools[2] = { 0, threads };
+	std::vector<uint8_t> pixels;
+
+	for (int k = 0; k < 2; k++) {
+		batch_env_t env(games, pools[k]);
+		double secs, reward;
+
+		if (frames)
+			env.set_pixels(frames, layers);
+
+		if (!batch_run(env, seed, steps, &secs, &reward, pixels, &digests[k])) {
+			fprintf(stderr, "the levels don't fit in a bot_state_t\n");
+			return 1;
+		}
+
+		printf("%zu games on %zu threads: %.3fs, %.0f steps/s, mean reward %.3f, digest %016llx\n",
+			   games, env.threads(), secs,
+			   games * steps / secs, reward / (games * (double)steps), (unsigned long long)digests[k]);
+	}
+
+	if (digests[0] != digests[1]) {
+		printf("MISMATCH: threaded run ended up somewhere else\n");
+		return 1;
+	}
+
+	/* every plane of every frame stacked top to bottom, as one gray image */
+	if (frames_out && frames) {
+		size_t planes = frames * (layers ? _kObsEnd : 1);
+		FILE* f = fopen(frames_out, "wb");
+
+		if (!f) {
+			fprintf(stderr, "can't write %s\n", frames_out);
+			return 1;
+		}
+
+		fprintf(f, "P5\n%d %zu\n255\n", OBS_PX_W, OBS_PX_H * planes);
+		fwrite(pixels.data(), OBS_PX_PLANE, planes, f);
+		fclose(f);
+	}
+
+	return 0;
+}
+
+/*
+ * -check: a good snapshot of a fresh game, broken one way at a time
+ * and resealed so only unmarshal's own checks stand in the way
+ */
+class snapshot_check_t {
+	std::vector<uint8_t> good;
+	int failed;
+
+	/* what the grid alien in record i can do, a bit per event_kind_t */
+	static int can(const snap_anchored_t& r) {
+		e_anchored_t* e = e_anchored_t::make(static_cast<texture_t>(r.base.tex));
+		int c = (dynamic_cast<e_fireable_t*>(e) ? 1 << kEvGridFire : 0) |
+				(dynamic_cast<e_cloakable_t*>(e) ? 1 << kEvGridCloak : 0);
+		delete e;
+		return c;
+	}
+
+public:
+	/* break a copy of the good snapshot with fn, which says if it could, and make sure it's turned down */
+	void expect_rejected(const char* what, std::function<bool(snapshot_view_t&)> fn) {
+		std::vector<uint8_t> buf(good);
+		snapshot_view_t v;
+		v.check(buf.data(), buf.size());
+
+		if (!fn(v)) {
+			printf("%-40s can't be set up\n", what);
+			failed++;
+			return;
+		}
+		v.seal();
+
+		sim_state_t s;
+		s.init(600, 500);
+		uint64_t before = s.digest();
+
+		bool ok = !s.unmarshal(buf.data(), buf.size()) && s.digest() == before;
+		printf("%-40s %s\n", what, ok ? "rejected" : "ACCEPTED");
+		if (!ok)
+			failed++;
+	}
+
+	/* first event of kind k moved to a grid alien that can't do it */
+	bool move_event(snapshot_view_t& v, int k) {
+		for (uint32_t a = 0; a < v.header->n_anchored; a++) {
+			if (can(v.anchored[a]) & (1 << k))
+				continue;
+
+			for (uint32_t i = 0; i < v.header->n_events; i++) {
+				if (v.events[i].kind == k) {
+					v.events[i].slot = a;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	int run() {
+		sim_state_t s;
+		s.init(600, 500);
+		s.marshal(good);
+
+		{
+			sim_state_t t;
+			t.init(600, 500);
+			bool ok = t.unmarshal(good.data(), good.size()) && t.digest() == s.digest();
+			printf("%-40s %s\n", "untouched snapshot", ok ? "loaded" : "NOT LOADED");
+			if (!ok)
+				failed++;
+		}
+
+		expect_rejected("two aliens in one cell", [](snapshot_view_t& v) {
+			if (v.header->n_anchored < 2)
+				return false;
+			v.anchored[1].col = v.anchored[0].col;
+			v.anchored[1].row = v.anchored[0].row;
+			return true;
+		});
+
+		expect_rejected("fire event for an alien that can't", [this](snapshot_view_t& v) {
+			return move_event(v, kEvGridFire);
+		});
+
+		expect_rejected("cloak event for an alien that can't", [this](snapshot_view_t& v) {
+			return move_event(v, kEvGridCloak);
+		});
+
+		return failed ? 1 : 0;
+	}
+
+	snapshot_check_t() : failed(0) {}
+};
+
+/* -check: pixel stacks can't be made empty, which would leave them nowhere to draw */
+static int check_pixels() {
+	int failed = 0;
+
+	batch_env_t env(4, 0);
+	bool ok = !env.set_pixels(0, false) && env.pixels_size() == 0;
+	printf("%-40s %s\n", "batch with 0 frames per stack", ok ? "rejected" : "ACCEPTED");
+	failed += !ok;
+
+	/* a stack asked for 0 frames still keeps 1 and goes round it */
+	sim_state_t s;
+	s.init(BATCH_SURFACE_W, BATCH_SURFACE_H);
+	s.reset_if_possible();
+
+	obs_raster_t r(BATCH_SURFACE_W, BATCH_SURFACE_H, false);
+	obs_stack_t stack(r.frame_size(), 0);
+	std::vector<uint8_t> frame(r.frame_size()), out(stack.size());
+
+	stack.restart(r, s);
+	stack.push(r, s);
+	stack.read(out.data());
+	r.draw(s, frame.data());
+
+	ok = stack.size() == r.frame_size() && out == frame;
+	printf("%-40s %s\n", "stack of 0 frames", ok ? "holds 1" : "BROKEN");
+	failed += !ok;
+
+	return failed;
+}
+
+static int run_check() {
+	int failed = snapshot_check_t().run();
+	failed += check_pixels();
+	return failed ? 1 : 0;
+}
+
+/*
+ * -replay: play file back, 0 if it ends where it should. seek_to other
+ * than ~0 jumps there instead.
+ */
+static int run_replay(const char* path, uint64_t seek_to) {
+	replay_t replay;
+
+	if (!replay.load(path)) {
+		fprintf(stderr, "%s isn't a replay or is damaged\n", path);
+		return 1;
+	}
+
+	printf("replay: %llu ticks, %u inputs, %zu keyframes, seed %llu\n",
+		   (unsigned long long)replay.header.end_tick, replay.header.count,
+		   replay.keys.size(), (unsigned long long)replay.header.seed);
+
+	sim_t sim;
+
+	if (seek_to != ~0ULL) {
+		uint64_t from = 0;
+
+		auto start = stats_clock::now();
+		bool ok = replay.seek(sim, seek_to, &from);
+		uint64_t ns = stats_ns(stats_clock::now() - start);
+
+		if (!ok) {
+			printf("can't seek to tick %llu\n", (unsigned long long)seek_to);
+			return 1;
+		}
+
+		printf("seek to %llu: %.3fms (keyframe at %llu, %llu ticks played) digest %016llx\n",
+			   (unsigned long long)seek_to, ns / 1e6, (unsigned long long)from,
+			   (unsigned long long)(seek_to - from), (unsigned long long)sim.digest());
+		printf("level: %d points: %d\n", sim.get_level()+1, sim.get_points());
+		return 0;
+	}
+
+	if (!replay.start(sim)) {
+		fprintf(stderr, "%s can't be played with this build's limits\n", path);
+		return 1;
+	}
+
+	uint64_t bad_key = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	bool played = replay.play(sim, &bad_key);
+	auto end = std::chrono::steady_clock::now();
+
+	double secs = std::chrono::duration<double>(end - start).count();
+	bool ok = played && replay.matches(sim);
+
+	printf("seconds: %.3f\n", secs);
+	printf("ticks/s: %.0f\n", secs > 0 ? sim.get_tick() / secs : 0.0);
+	printf("level: %d points: %d\n", sim.get_level()+1, sim.get_points());
+
+	if (bad_key)
+		printf("first keyframe that doesn't match: tick %llu\n", (unsigned long long)bad_key);
+
+	if (!ok) {
+		printf("MISMATCH: %s at tick %llu, digest %016llx, recorded %016llx\n",
+			   played ? "different state" : "stopped early", (unsigned long long)sim.get_tick(),
+			   (unsigned long long)sim.digest(), (unsigned long long)replay.header.digest);
+		return 1;
+	}
+
+	printf("end state matches (%016llx)\n", (unsigned long long)replay.header.digest);
+	return 0;
+}
+
+int main(int argc, const char * argv[])
+{
+	unsigned long ticks = 1000000;
+	uint64_t seed = 1;
+	bool latency = false, render = false, partial = false;
+	const char* frame_out = NULL;
+	unsigned long autosave_every = 0;
+	const char* record_out = NULL;
+	uint32_t keyframe_every = REPLAY_KEYFRAME_TICKS;
+	const char* replay_in = NULL;
+	uint64_t seek_to = ~0ULL;
+	bool bench = false;
+	size_t games = 0;
+	unsigned threads = ~0u;
+	bool ticks_set = false;
+	size_t frames = 0;
+	bool layers = false;
+	bool check = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-t") && i+1 < argc)
+			ticks = strtoul(argv[++i], NULL, 10), ticks_set = true;
+		else if (!strcmp(argv[i], "-s") && i+1 < argc)
+			seed = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "-l"))
+			latency = true;
+		else if (!strcmp(argv[i], "-r"))
+			render = true;
+		else if (!strcmp(argv[i], "-p"))
+			partial = render = true;
+		else if (!strcmp(argv[i], "-o") && i+1 < argc)
+			frame_out = argv[++i], render = true;
+		else if (!strcmp(argv[i], "-a") && i+1 < argc)
+			autosave_every = strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "-w") && i+1 < argc)
+			record_out = argv[++i];
+		else if (!strcmp(argv[i], "-k") && i+1 < argc)
+			keyframe_every = static_cast<uint32_t>(strtoul(argv[++i], NULL, 10));
+		else if (!strcmp(argv[i], "-replay") && i+1 < argc)
+			replay_in = argv[++i];
+		else if (!strcmp(argv[i], "-seek") && i+1 < argc)
+			seek_to = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "-b"))
+			bench = true;
+		else if (!strcmp(argv[i], "-e") && i+1 < argc)
+			games = strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "-j") && i+1 < argc)
+			threads = static_cast<unsigned>(strtoul(argv[++i], NULL, 10));
+		else if (!strcmp(argv[i], "-x") && i+1 < argc)
+			frames = strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "-c"))
+			layers = true;
+		else if (!strcmp(argv[i], "-check"))
+			check = true;
+		else {
+			fprintf(stderr, "usage: %s [-t ticks] [-s seed] [-l] [-r] [-p] [-o frame.ppm] [-a ticks] [-w replay [-k ticks]]\n"
+					"       %s -replay file [-seek tick]\n"
+					"       %s -b [-s seed]\n"
+					"       %s -e games [-t steps] [-j threads] [-s seed] [-x frames [-c]]\n"
+					"       %s -check\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
+			return 1;
+		}
+	}
+
+	if (check)
+		return run_check();
+
+	if (replay_in)
+		return run_replay(replay_in, seek_to);
+
+	if (bench)
+		return run_bench(seed);
+
+	if (games)
+		return run_batch(seed, games, ticks_set ? ticks : 1000, threads, frames, layers, frame_out);
+
+	scene_t sim;
+	autopilot_t pilot;
+	stats_t stats;
+	soft_renderer_t rend;
+	file_writer_t writer;
+	replay_recorder_t recorder;
+
+	autosave_t autosaver(writer, stats, AUTOSAVE_FILE, TICK_BUDGET_NS);
+	autosaver.set_interval(autosave_every);
+
+	/* seed PRNG */
+	sim.seed(seed);
+
+	if (!sim.init(600, 500)) {
+		fprintf(stderr, "the levels don't fit in the game's limits (capacity.h)\n");
+		return 1;
+	}
+	
+	if (record_out) {
+		recorder.start(sim, 600, 500, 0, keyframe_every);
+		pilot.recorder = &recorder;
+	}
+	
+	if (render) {
+		rend.surface_w = 600;
+		rend.surface_h = 500;
+		rend.init_state();
+
+		auto l0 = stats_clock::now();
+		bool baked = sim.load_textures(rend);
+		printf("textures: %s, %.2fms\n", baked ? "baked pack" : "decoded", stats_ns(stats_clock::now() - l0) / 1e6);
+
+		sim.set_damage_tracking(partial);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (latency || render || autosave_every || record_out) {
+		for (unsigned long t = 0; t < ticks; t++) {
+			pilot.step(sim, t);
+			
+			auto t0 = stats_clock::now();
+			sim.tick();
+			auto t1 = stats_clock::now();
+			
+			if (latency)
+				stats.on_tick(stats_ns(t1 - t0));
+			
+			autosaver.after_tick(sim, stats_ns(t1 - t0));
+			recorder.after_tick(sim);
+			
+			if (render) {
+				if (partial)
+					sim.draw_damaged(rend);
+				else
+					sim.draw(rend);
+				stats.on_frame(stats_ns(stats_clock::now() - t1));
+			}
+		}
+	}
+	else {
+		for (unsigned long t = 0; t < ticks; t++) {
+			pilot.step(sim, t);
+			sim.tick();
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	if (record_out) {
+		std::vector<uint8_t> buf;
+		recorder.finish(sim, buf);
+		writer.submit(record_out, std::move(buf));
+	}
+
+	/* the autosave numbers aren't all in until the last one is written */
+	writer.drain();
+
+	double secs = std::chrono::duration<double>(end - start).count();
+
+	printf("ticks: %lu\n", ticks);
+	printf("seconds: %.3f\n", secs);
+	printf("ticks/s: %.0f\n", secs > 0 ? ticks / secs : 0.0);
+	printf("rounds won: %lu lost: %lu\n", pilot.rounds_won, pilot.rounds_lost);
+	printf("level: %d points: %d\n", sim.get_level()+1, sim.get_points());
+	
+	if (latency) {
+		histogram_t& h = stats.tick_ns;
+		printf("tick ns: p50 %llu p90 %llu p99 %llu p99.9 %llu max %llu mean %llu\n",
+			   (unsigned long long)h.percentile(0.5), (unsigned long long)h.percentile(0.9),
+			   (unsigned long long)h.percentile(0.99), (unsigned long long)h.percentile(0.999),
+			   (unsigned long long)h.max(), (unsigned long long)h.mean());
+	}
+	
+	if (render) {
+		histogram_t& h = stats.frame_ns;
+		printf("frame ns: p50 %llu p99 %llu max %llu mean %llu\n",
+			   (unsigned long long)h.percentile(0.5), (unsigned long long)h.percentile(0.99),
+			   (unsigned long long)h.max(), (unsigned long long)h.mean());
+	}
+	
+	if (autosave_every) {
+		histogram_t& c = stats.autosave_capture_ns;
+		histogram_t& w = stats.autosave_write_ns;
+		printf("autosaves: %llu capture ns p50 %llu p99 %llu max %llu over budget %llu | write ns p50 %llu max %llu written %lu failed %llu\n",
+			   (unsigned long long)stats.autosaves, (unsigned long long)c.percentile(0.5),
+			   (unsigned long long)c.percentile(0.99), (unsigned long long)c.max(),
+			   (unsigned long long)stats.autosave_over_budget,
+			   (unsigned long long)w.percentile(0.5), (unsigned long long)w.max(),
+			   (unsigned long)writer.written, (unsigned long long)stats.autosave_failed);
+	}
+	
+	if (frame_out && !rend.write_ppm(frame_out)) {
+		fprintf(stderr, "can't write %s\n", frame_out);
+		return 1;
+	}
+
+	return 0;
+}
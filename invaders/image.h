@@ -0,0 +1,310 @@
+/*
+ * space invaders game - image loading
+ *
+ * decodes the sprite files into RGBA8 with premultiplied alpha, which
+ * is what both renderers blend with. on OSX CoreGraphics does the work,
+ * everywhere else libpng and libjpeg (link with -lpng -ljpeg). all the
+ * files are decoded at once on a worker pool, the results own their
+ * pixels so nothing needs freeing by hand.
+ */
+
+#ifndef INVADERS_IMAGE_H
+#define INVADERS_IMAGE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if __APPLE__
+#include <CoreGraphics/CoreGraphics.h>
+#include <ImageIO/ImageIO.h>
+#else
+#include <setjmp.h>
+#include <png.h>
+#include <jpeglib.h>
+#endif
+
+#include "pool.h"
+
+/***************************************************************
+ * PIXEL CONVERSION
+ ***************************************************************/
+
+/* R, G, B, A bytes per pixel, premultiplied, top row first */
+struct image_t {
+	int w, h;
+	std::vector<uint32_t> px;
+
+	image_t() : w(0), h(0) {}
+};
+
+/* same layout, pixels owned by someone else (e.g. a mapped asset pack) */
+struct image_view_t {
+	int w, h;
+	const uint32_t* px;
+};
+
+/* scale the color channels by alpha, in place */
+inline void premultiply(uint32_t* px, size_t n) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i amask = _mm_set1_epi32(0xff000000);
+	const __m128i c128 = _mm_set1_epi16(128);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(px + i));
+		__m128i a = _mm_and_si128(p, amask);
+
+		/* opaque pixels stay as they are */
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, amask)) == 0xffff)
+			continue;
+
+		__m128i lo = _mm_unpacklo_epi8(p, zero), hi = _mm_unpackhi_epi8(p, zero);
+		__m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+		__m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+
+		/* c * a / 255, rounded */
+		lo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), c128);
+		hi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), c128);
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+		/* alpha itself came out as a*a/255, put the original back */
+		__m128i out = _mm_packus_epi16(lo, hi);
+		out = _mm_or_si128(_mm_andnot_si128(amask, out), a);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(px + i), out);
+	}
+#endif
+
+	for (; i < n; i++) {
+		uint32_t p = px[i];
+		unsigned a = p >> 24;
+
+		if (a == 255)
+			continue;
+
+		uint32_t out = p & 0xff000000;
+		for (int sh = 0; sh < 24; sh += 8) {
+			unsigned t = ((p >> sh) & 0xff) * a + 128;
+			out |= ((t + (t >> 8)) >> 8) << sh;
+		}
+		px[i] = out;
+	}
+}
+
+/* packed RGB to opaque RGBA */
+inline void rgb_to_rgba(const uint8_t* rgb, uint32_t* out, size_t n) {
+	size_t i = 0;
+
+#if defined(__SSSE3__)
+	/* 4 pixels per step, the 16 byte load reads 4 bytes past them */
+	const __m128i shuf = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i amask = _mm_set1_epi32(0xff000000);
+
+	for (; i + 6 <= n; i += 4) {
+		__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+		p = _mm_or_si128(_mm_shuffle_epi8(p, shuf), amask);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), p);
+	}
+#endif
+
+	for (; i < n; i++) {
+		const uint8_t* p = rgb + i * 3;
+		uint8_t* o = reinterpret_cast<uint8_t*>(out + i);
+		o[0] = p[0];
+		o[1] = p[1];
+		o[2] = p[2];
+		o[3] = 255;
+	}
+}
+
+/***************************************************************
+ * DECODING
+ ***************************************************************/
+
+#if __APPLE__
+/*
+ * let CoreGraphics draw the image into a bitmap we own in exactly the
+ * format we want, whatever format the file was in.
+ */
+inline bool decode_image(const char* path, image_t& img) {
+	CFStringRef cfstr = CFStringCreateWithCString(NULL, path, kCFStringEncodingUTF8);
+	if (!cfstr)
+		return false;
+
+	CFURLRef url = CFURLCreateWithFileSystemPath(NULL, cfstr, kCFURLPOSIXPathStyle, FALSE);
+	CFRelease(cfstr);
+	if (!url)
+		return false;
+
+	CGImageSourceRef imgsrc = CGImageSourceCreateWithURL(url, NULL);
+	CFRelease(url);
+	if (!imgsrc)
+		return false;
+
+	CGImageRef cg = CGImageSourceCreateImageAtIndex(imgsrc, 0, NULL);
+	CFRelease(imgsrc);
+	if (!cg)
+		return false;
+
+	img.w = static_cast<int>(CGImageGetWidth(cg));
+	img.h = static_cast<int>(CGImageGetHeight(cg));
+	img.px.assign(img.w * img.h, 0);
+
+	CGColorSpaceRef cs = CGColorSpaceCreateDeviceRGB();
+	CGContextRef ctx = CGBitmapContextCreate(img.px.data(), img.w, img.h, 8, img.w * 4, cs,
+											 kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+	CGColorSpaceRelease(cs);
+
+	if (ctx) {
+		CGContextDrawImage(ctx, CGRectMake(0, 0, img.w, img.h), cg);
+		CGContextRelease(ctx);
+	}
+
+	CGImageRelease(cg);
+	return ctx != NULL;
+}
+#else
+inline bool decode_png(const char* path, image_t& img) {
+	png_image png;
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&png, path))
+		return false;
+
+	/* libpng expands palettes, gray and 16 bit for us */
+	png.format = PNG_FORMAT_RGBA;
+	img.w = png.width;
+	img.h = png.height;
+	img.px.resize(img.w * img.h);
+
+	if (!png_image_finish_read(&png, NULL, img.px.data(), 0, NULL)) {
+		png_image_free(&png);
+		return false;
+	}
+
+	premultiply(img.px.data(), img.px.size());
+	return true;
+}
+
+/* libjpeg's default error handler exits the process, jump out instead */
+struct jpeg_error_t {
+	jpeg_error_mgr mgr;
+	jmp_buf escape;
+
+	static void error_exit(j_common_ptr c) {
+		longjmp(reinterpret_cast<jpeg_error_t*>(c->err)->escape, 1);
+	}
+
+	static void output_message(j_common_ptr) {}
+};
+
+inline bool decode_jpeg(const char* path, image_t& img) {
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return false;
+
+	jpeg_decompress_struct cinfo;
+	jpeg_error_t err;
+
+	cinfo.err = jpeg_std_error(&err.mgr);
+	err.mgr.error_exit = jpeg_error_t::error_exit;
+	err.mgr.output_message = jpeg_error_t::output_message;
+
+	if (setjmp(err.escape)) {
+		jpeg_destroy_decompress(&cinfo);
+		fclose(f);
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, f);
+	jpeg_read_header(&cinfo, TRUE);
+
+	/* gray comes out as RGB too */
+	cinfo.out_color_space = JCS_RGB;
+	jpeg_start_decompress(&cinfo);
+
+	img.w = cinfo.output_width;
+	img.h = cinfo.output_height;
+	img.px.resize(img.w * img.h);
+
+	/* scanline buffer from libjpeg's pool, freed with the decompressor */
+	JSAMPARRAY row = (*cinfo.mem->alloc_sarray)(reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_IMAGE, img.w * 3, 1);
+
+	while (cinfo.output_scanline < cinfo.output_height) {
+		uint32_t* out = &img.px[cinfo.output_scanline * img.w];
+		jpeg_read_scanlines(&cinfo, row, 1);
+		rgb_to_rgba(row[0], out, img.w);
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	fclose(f);
+	return true;
+}
+
+/* sniff the file type, extensions lie */
+inline bool decode_image(const char* path, image_t& img) {
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return false;
+
+	uint8_t magic[8] = {0};
+	size_t got = fread(magic, 1, sizeof(magic), f);
+	fclose(f);
+
+	static const uint8_t png_magic[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	if (got == 8 && !memcmp(magic, png_magic, 8))
+		return decode_png(path, img);
+	if (got >= 3 && magic[0] == 0xff && magic[1] == 0xd8 && magic[2] == 0xff)
+		return decode_jpeg(path, img);
+
+	return false;
+}
+#endif
+
+/* the decoders' threads, started on first use and kept for the rest of the program */
+inline worker_pool_t& image_pool() {
+	static worker_pool_t pool;
+	return pool;
+}
+
+/*
+ * decode n files at once, one per worker. NULL paths are skipped. a
+ * file that can't be read leaves its image empty (w == 0), returns how
+ * many were decoded. one call at a time, the workers are shared.
+ */
+inline size_t load_images(const char* const* paths, size_t n, image_t* out) {
+	if (!n)
+		return 0;
+
+	std::vector<char> ok(n, 0);
+
+	image_pool().run(n, [&](size_t i) {
+		if (paths[i] && decode_image(paths[i], out[i]))
+			ok[i] = 1;
+		else
+			out[i] = image_t();
+	});
+
+	size_t decoded = 0;
+	for (size_t i = 0; i < n; i++)
+		decoded += ok[i];
+	return decoded;
+}
+
+#endif /* INVADERS_IMAGE_H */
@@ -0,0 +1,81 @@
+/*
+ * space invaders game - read-only file mappings
+ *
+ * the asset pack and saved games are read straight out of a mapping of
+ * the file instead of being copied into memory first.
+ */
+
+#ifndef INVADERS_MAPFILE_H
+#define INVADERS_MAPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if __WINDOWS__
+#error add win32 support
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+class mapped_file_t {
+	const uint8_t* base;
+	size_t len;
+
+	mapped_file_t(const mapped_file_t&);
+	mapped_file_t& operator=(const mapped_file_t&);
+
+public:
+	/* map all of path, an empty file doesn't count */
+	bool open(const char* path) {
+		close();
+
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+			::close(fd);
+			return false;
+		}
+
+		void* p = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+		/* the mapping keeps the file alive */
+		::close(fd);
+
+		if (p == MAP_FAILED)
+			return false;
+
+		base = static_cast<const uint8_t*>(p);
+		len = static_cast<size_t>(st.st_size);
+		return true;
+	}
+
+	void close() {
+		if (base)
+			munmap(const_cast<uint8_t*>(base), len);
+
+		base = NULL;
+		len = 0;
+	}
+
+	const uint8_t* data() const {
+		return base;
+	}
+
+	size_t size() const {
+		return len;
+	}
+
+	mapped_file_t() : base(NULL), len(0) {}
+
+	~mapped_file_t() {
+		close();
+	}
+};
+
+#endif /* INVADERS_MAPFILE_H */
@@ -0,0 +1,163 @@
+/*
+ * space invaders game - pixel observations
+ *
+ * draws the game for bots straight at low resolution: every rect from
+ * basic_sim_state_t::each_rect is scaled down and filled into a small uint8
+ * frame (OBS_PX_W x OBS_PX_H), either one gray plane with each layer in
+ * its own shade or a plane per layer (player, invaders, shots). nothing
+ * is drawn at full size and there are no sprites, a thing is its box.
+ * anything on screen covers at least one pixel, however small it gets.
+ *
+ * obs_stack_t keeps the last few frames in a ring, drawing each new one
+ * over the oldest, so a bot can see which way things are moving.
+ */
+
+#ifndef INVADERS_OBS_H
+#define INVADERS_OBS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "sim.h"
+
+#define OBS_PX_W 84
+#define OBS_PX_H 84
+#define OBS_PX_PLANE (OBS_PX_W * OBS_PX_H)
+
+/* shade of each layer in a gray frame, overlaps keep the brightest */
+static const uint8_t obs_gray[_kObsEnd] = { 255, 128, 192 };
+
+/*
+ * dst[i] = max(dst[i], v) for n bytes, room is how many bytes there are
+ * from dst to the end of the plane. 16 at a time with SSE2, and a short
+ * span (most of them, an alien is a handful of pixels across) is one
+ * masked 16 byte max as long as it doesn't run off the plane. the bytes
+ * past the span get max'd with 0, which leaves them as they were.
+ */
+inline void obs_span(uint8_t* dst, size_t n, uint8_t v, size_t room) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	static const uint8_t mask[32] = {
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	};
+	const __m128i vv = _mm_set1_epi8(static_cast<char>(v));
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i* p = reinterpret_cast<__m128i*>(dst + i);
+		_mm_storeu_si128(p, _mm_max_epu8(_mm_loadu_si128(p), vv));
+	}
+
+	if (i < n && room - i >= 16) {
+		__m128i m = _mm_and_si128(vv, _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + 16 - (n - i))));
+		__m128i* p = reinterpret_cast<__m128i*>(dst + i);
+		_mm_storeu_si128(p, _mm_max_epu8(_mm_loadu_si128(p), m));
+		return;
+	}
+#else
+	(void)room;
+#endif
+
+	for (; i < n; i++)
+		dst[i] = std::max(dst[i], v);
+}
+
+class obs_raster_t {
+	/* surface to observation scale */
+	float sx, sy;
+
+	/* 1 gray plane, or one per obs_layer_t */
+	size_t planes;
+
+	void fill(uint8_t* frame, obs_layer_t l, const rect_t& r) {
+		/* edges to the nearest pixel boundary, so gaps stay gaps, but never less than a pixel */
+		int x0 = static_cast<int>(floorf(r.pt.x * sx + 0.5f));
+		int y0 = static_cast<int>(floorf(r.pt.y * sy + 0.5f));
+		int x1 = std::max(x0 + 1, static_cast<int>(floorf((r.pt.x + r.w) * sx + 0.5f)));
+		int y1 = std::max(y0 + 1, static_cast<int>(floorf((r.pt.y + r.h) * sy + 0.5f)));
+
+		x0 = std::max(x0, 0);
+		y0 = std::max(y0, 0);
+		x1 = std::min(x1, OBS_PX_W);
+		y1 = std::min(y1, OBS_PX_H);
+
+		if (x0 >= x1 || y0 >= y1)
+			return;
+
+		uint8_t* plane = planes == 1 ? frame : frame + l * OBS_PX_PLANE;
+		uint8_t v = planes == 1 ? obs_gray[l] : 255;
+
+		for (int y = y0; y < y1; y++) {
+			size_t at = y * OBS_PX_W + x0;
+			obs_span(plane + at, x1 - x0, v, OBS_PX_PLANE - at);
+		}
+	}
+
+public:
+	/* bytes in a frame */
+	size_t frame_size() {
+		return planes * OBS_PX_PLANE;
+	}
+
+	/* frame_size() bytes, the planes one after the other, rows top down. s is any basic_sim_state_t */
+	template <class S>
+	void draw(S& s, uint8_t* frame) {
+		memset(frame, 0, frame_size());
+		s.each_rect([&](obs_layer_t l, const rect_t& r) { fill(frame, l, r); });
+	}
+
+	/* for a surface_w x surface_h game, layers gives a plane per layer */
+	obs_raster_t(float surface_w, float surface_h, bool layers) :
+		sx(OBS_PX_W / surface_w), sy(OBS_PX_H / surface_h), planes(layers ? _kObsEnd : 1) {}
+};
+
+/* the last depth frames, oldest first when read out */
+class obs_stack_t {
+	std::vector<uint8_t> ring;
+	size_t frame, depth;
+
+	/* slot the next frame goes in, which is the oldest */
+	size_t head;
+
+public:
+	/* bytes read() writes */
+	size_t size() {
+		return frame * depth;
+	}
+
+	/* draw s as the newest frame, over the oldest */
+	template <class S>
+	void push(obs_raster_t& r, S& s) {
+		r.draw(s, &ring[head * frame]);
+		head = (head + 1) % depth;
+	}
+
+	/* start over (new game), s fills every slot as if it had been there all along */
+	template <class S>
+	void restart(obs_raster_t& r, S& s) {
+		r.draw(s, &ring[0]);
+		for (size_t k = 1; k < depth; k++)
+			memcpy(&ring[k * frame], &ring[0], frame);
+		head = 1 % depth;
+	}
+
+	void read(uint8_t* out) {
+		size_t older = (depth - head) * frame;
+		memcpy(out, &ring[head * frame], older);
+		memcpy(out + older, &ring[0], head * frame);
+	}
+
+	/* at least one frame, a stack of none would have nowhere to draw */
+	obs_stack_t(size_t frame_size, size_t frames) :
+		ring(frame_size * std::max<size_t>(frames, 1)), frame(frame_size), depth(std::max<size_t>(frames, 1)), head(0) {}
+};
+
+#endif /* INVADERS_OBS_H */
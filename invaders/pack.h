@@ -0,0 +1,160 @@
+/*
+ * space invaders game - baked asset pack
+ *
+ * invaders-bake (bake.cc) decodes every sprite once and writes them,
+ * with their whole mip chains already built, into one file:
+ *
+ *   pack_header_t
+ *   pack_entry_t * count     (the index, one per sprite)
+ *   pixels                   (premultiplied RGBA8, every level 16 byte aligned)
+ *
+ * the game maps the file and hands the levels straight to the renderer,
+ * so startup is one open, one mmap and the uploads. numbers are in host
+ * byte order, the pack is baked on the machine it's for.
+ */
+
+#ifndef INVADERS_PACK_H
+#define INVADERS_PACK_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "image.h"
+#include "mapfile.h"
+
+#define ASSET_PACK_FILE "images/sprites.pack"
+
+#define PACK_MAGIC "IVPK"
+#define PACK_VERSION 1
+
+/* enough for a 32768 pixel wide sprite */
+#define PACK_MAX_LEVELS 16
+#define PACK_ALIGN 16
+
+struct pack_header_t {
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+
+	/* whole file, so a truncated pack is caught before anything reads it */
+	uint64_t size;
+};
+
+struct pack_entry_t {
+	/* texture_t the sprite is for */
+	uint32_t id;
+	uint32_t w, h;
+	uint32_t levels;
+
+	/* file offset of each level, level i is max(w >> i, 1) * max(h >> i, 1) */
+	uint64_t off[PACK_MAX_LEVELS];
+};
+
+inline uint32_t pack_level_dim(uint32_t d, uint32_t level) {
+	return (d >> level) ? (d >> level) : 1;
+}
+
+/* round up to PACK_ALIGN */
+inline uint64_t pack_align(uint64_t off) {
+	return (off + PACK_ALIGN - 1) & ~static_cast<uint64_t>(PACK_ALIGN - 1);
+}
+
+/*
+ * a read-only mapping of a pack. the level views it hands out point
+ * into the mapping and stay valid until close() or the destructor.
+ */
+class asset_pack_t {
+	mapped_file_t file;
+
+	const pack_header_t* header;
+	const pack_entry_t* index;
+
+	/* everything the index says has to be inside the file */
+	bool check() {
+		const uint8_t* base = file.data();
+		size_t len = file.size();
+
+		if (len < sizeof(pack_header_t))
+			return false;
+
+		header = reinterpret_cast<const pack_header_t*>(base);
+
+		if (memcmp(header->magic, PACK_MAGIC, 4) || header->version != PACK_VERSION || header->size != len)
+			return false;
+
+		if (header->count > (len - sizeof(pack_header_t)) / sizeof(pack_entry_t))
+			return false;
+
+		index = reinterpret_cast<const pack_entry_t*>(base + sizeof(pack_header_t));
+
+		for (uint32_t i = 0; i < header->count; i++) {
+			const pack_entry_t& e = index[i];
+
+			if (!e.w || !e.h || !e.levels || e.levels > PACK_MAX_LEVELS || e.w > 32768 || e.h > 32768)
+				return false;
+
+			for (uint32_t l = 0; l < e.levels; l++) {
+				uint64_t bytes = 4ULL * pack_level_dim(e.w, l) * pack_level_dim(e.h, l);
+
+				if (e.off[l] % PACK_ALIGN || e.off[l] > len || bytes > len - e.off[l])
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+public:
+	bool open(const char* path) {
+		close();
+
+		if (!file.open(path))
+			return false;
+
+		if (!check()) {
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void close() {
+		file.close();
+		header = NULL;
+		index = NULL;
+	}
+
+	bool is_open() const {
+		return file.data() != NULL;
+	}
+
+	/*
+	 * fill levels[] with sprite id's mip chain, largest first. returns
+	 * the number of levels, 0 if the pack doesn't have that sprite.
+	 */
+	int levels_of(uint32_t id, image_view_t* levels) const {
+		if (!is_open())
+			return 0;
+
+		for (uint32_t i = 0; i < header->count; i++) {
+			const pack_entry_t& e = index[i];
+			if (e.id != id)
+				continue;
+
+			for (uint32_t l = 0; l < e.levels; l++) {
+				levels[l].w = pack_level_dim(e.w, l);
+				levels[l].h = pack_level_dim(e.h, l);
+				levels[l].px = reinterpret_cast<const uint32_t*>(file.data() + e.off[l]);
+			}
+			return e.levels;
+		}
+
+		return 0;
+	}
+
+	asset_pack_t() : header(NULL), index(NULL) {}
+};
+
+#endif /* INVADERS_PACK_H */
@@ -0,0 +1,122 @@
+/*
+ * space invaders game - worker pool
+ *
+ * a fixed set of threads that run parallel-for style jobs: run(n, fn)
+ * calls fn(0) .. fn(n-1) spread over the workers and the calling thread
+ * and returns once they've all finished. that's all the parallelism
+ * the game needs (decoding images, stepping lots of sims at once).
+ */
+
+#ifndef INVADERS_POOL_H
+#define INVADERS_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class worker_pool_t {
+	std::vector<std::thread> threads;
+
+	std::mutex m;
+	std::condition_variable work_cv, done_cv;
+
+	/* the current job, handed out an index at a time */
+	const std::function<void(size_t)>* job;
+	size_t job_n;
+	std::atomic<size_t> next;
+
+	/* workers still on the current job */
+	size_t busy;
+
+	/* bumped for every job so sleeping workers know there's a new one */
+	uint64_t generation;
+	bool quit;
+
+	void drain() {
+		size_t i;
+		while ((i = next++) < job_n)
+			(*job)(i);
+	}
+
+	void worker() {
+		uint64_t seen = 0;
+
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> l(m);
+				work_cv.wait(l, [&] { return quit || generation != seen; });
+
+				if (quit)
+					return;
+
+				seen = generation;
+			}
+
+			drain();
+
+			std::lock_guard<std::mutex> l(m);
+			if (--busy == 0)
+				done_cv.notify_all();
+		}
+	}
+
+public:
+	/* run fn(i) for every i in [0, n), returns when all calls are done */
+	void run(size_t n, const std::function<void(size_t)>& fn) {
+		if (threads.empty() || n < 2) {
+			for (size_t i = 0; i < n; i++)
+				fn(i);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> l(m);
+			job = &fn;
+			job_n = n;
+			next = 0;
+			busy = threads.size();
+			generation++;
+		}
+		work_cv.notify_all();
+
+		/* the calling thread pitches in too */
+		drain();
+
+		std::unique_lock<std::mutex> l(m);
+		done_cv.wait(l, [&] { return busy == 0; });
+	}
+
+	/* threads working on a job, the caller included */
+	size_t size() {
+		return threads.size() + 1;
+	}
+
+	/* n extra threads, by default one less than there are cores */
+	explicit worker_pool_t(unsigned n = ~0u) : job(NULL), job_n(0), next(0), busy(0), generation(0), quit(false) {
+		if (n == ~0u) {
+			unsigned hw = std::thread::hardware_concurrency();
+			n = hw > 1 ? hw - 1 : 0;
+		}
+
+		for (unsigned i = 0; i < n; i++)
+			threads.emplace_back(&worker_pool_t::worker, this);
+	}
+
+	~worker_pool_t() {
+		{
+			std::lock_guard<std::mutex> l(m);
+			quit = true;
+		}
+		work_cv.notify_all();
+
+		for (auto& t : threads)
+			t.join();
+	}
+};
+
+#endif /* INVADERS_POOL_H */
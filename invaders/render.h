@@ -0,0 +1,424 @@
+/*
+ * space invaders game - renderer interface and scene drawing
+ *
+ * renderer_t is what the scene draws through. the GL renderer lives in
+ * main.cc, the CPU one in softrender.h. scene_t is the simulation plus
+ * the code that draws it, so any front end (the GLUT game, headless
+ * runs) draws exactly the same frame through whichever renderer it has.
+ */
+
+#ifndef INVADERS_RENDER_H
+#define INVADERS_RENDER_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+#include "image.h"
+#include "pack.h"
+
+/***************************************************************
+ * RENDERER INTERFACE
+ ***************************************************************/
+
+/*
+ * coordinates are in pixels, origin top left. textures are handles
+ * handed out by load_texture(), 0 is "no texture".
+ */
+class renderer_t {
+public:
+	float surface_w, surface_h;
+
+	/* make a texture out of a decoded image */
+	virtual unsigned load_texture(const image_t& img) = 0;
+
+	/*
+	 * same from a ready made mip chain, largest level first. the pixels
+	 * have to stay put as long as the renderer is around (they normally
+	 * live in a mapped asset pack), so nothing needs copying.
+	 */
+	virtual unsigned load_texture_levels(const image_view_t* levels, int n) = 0;
+
+	/* set up for drawing, called once the surface size is known */
+	virtual void init_state() = 0;
+
+	virtual void clear() = 0;
+
+	/* select a loaded texture for the following fill_quad()s */
+	virtual void bind_tex(unsigned tex) = 0;
+
+	/*
+	 * draw a w*h quad at x, y. if textured the bound texture is stretched
+	 * over it (mirrored horizontally, that's how the sprites are stored)
+	 * and tinted by r, g, b. blending expects premultiplied alpha.
+	 */
+	virtual void fill_quad(float x, float y, float w, float h, bool textured=true, float r=1, float g=1, float b=1, bool blend=true) = 0;
+
+	/* draw a string in the 9x15 font, on top of everything before it */
+	virtual void draw_string(float x, float y, const char* s, float r=1, float g=1, float b=1) = 0;
+
+	/*
+	 * only touch pixels inside x, y, w, h (rounded out to whole pixels)
+	 * until clear_clip(), clear() included.
+	 */
+	virtual void set_clip(float x, float y, float w, float h) = 0;
+	virtual void clear_clip() = 0;
+
+	/* same but centered horizontally */
+	void draw_stringm(float y, const char* s, float r=1, float g=1, float b=1) {
+		float mid = (surface_w / 2) - ((float)(strlen(s) * 9) / 2);
+		draw_string(mid, y, s, r, g, b);
+	}
+
+	/* everything for this frame has been drawn */
+	virtual void end_frame() {}
+
+	renderer_t() : surface_w(0), surface_h(0) {}
+	virtual ~renderer_t() {}
+};
+
+/***************************************************************
+ * HUD
+ ***************************************************************/
+
+/*
+ * the HUD lines only change when a life is lost, points are scored or
+ * a level starts, so they're formatted once and kept until one of the
+ * numbers in them changes. `version` goes up every time a line is
+ * re-laid-out.
+ */
+class hud_cache_t {
+	int level, lives, points, highscore;
+	char status[128];
+
+	int mothership_lives;
+	char mothership[64];
+
+public:
+	unsigned long version;
+
+	const char* status_line(int lv, int li, int pts, int hs) {
+		if (lv != level || li != lives || pts != points || hs != highscore) {
+			level = lv; lives = li; points = pts; highscore = hs;
+			snprintf(status, sizeof(status), "Level: %d Lives: %d Score: %d Highscore: %d", level+1, lives, points, highscore);
+			version++;
+		}
+		return status;
+	}
+
+	const char* mothership_line(int li) {
+		if (li != mothership_lives) {
+			mothership_lives = li;
+			snprintf(mothership, sizeof(mothership), "Mothership: %d Lives Left", mothership_lives);
+			version++;
+		}
+		return mothership;
+	}
+
+	hud_cache_t() : level(-1), lives(-1), points(-1), highscore(-1), mothership_lives(-1), version(0) {
+		status[0] = mothership[0] = '\0';
+	}
+};
+
+/***************************************************************
+ * SCENE
+ ***************************************************************/
+
+/* status line plus the mothership line under it */
+#define HUD_HEIGHT 36.0f
+
+class scene_t : public sim_t {
+protected:
+	/* texture array */
+	unsigned textures[_kTexEnd];
+
+	/* baked sprites, mapped for as long as the renderer may look at them */
+	asset_pack_t pack;
+
+	/* how far we are into the next tick, for interpolation (0..1) */
+	float alpha;
+
+	hud_cache_t hud;
+
+	/* what the last draw painted moving things over, see draw_damaged() */
+	damage_t last_damage;
+	unsigned long hud_drawn;
+
+	/*
+	 * while draw_damaged() paints one of its rects, sprites that don't
+	 * touch it are skipped instead of being handed to the renderer to
+	 * clip away. it's a couple of pixels bigger than the clip, which is
+	 * rounded out to whole pixels, so a skipped sprite couldn't have
+	 * put a pixel inside it.
+	 */
+	rect_t cull;
+	bool culling;
+
+	inline bool in_cull(float x, float y, float w, float h) {
+		return !culling || rect_touches(cull, { { x, y }, w, h });
+	}
+
+	/* the title screen offers to load a saved game if there is one */
+	virtual bool has_savegame_file() {
+		return false;
+	}
+
+	/* bind mapped texture by ID */
+	inline void bmap_tex(renderer_t& rend, texture_t t) {
+		rend.bind_tex(textures[t]);
+	}
+
+	/* interpolated position, p_on says if there was a previous position */
+	inline pt_t ipos(pt_t p, pt_t cur, bool p_on = true) {
+		return p_on ? lerp_pt(p, cur, alpha) : cur;
+	}
+
+	void draw_independent_enemy(renderer_t& rend, e_independent_t& e, pt_t p, bool p_on) {
+		if (!e.is_visible())
+			return;
+
+		pt_t pos = ipos(p, e.get_pt(), p_on);
+		if (!in_cull(pos.x, pos.y, e.w, e.h))
+			return;
+
+		bmap_tex(rend, e.get_texture_id());
+		rend.fill_quad(pos.x, pos.y, e.w, e.h, true, 1, 1, 1, false);
+	}
+
+	/*
+	 * paint the whole scene (or whatever the renderer clips it to).
+	 * everything that moves is drawn between where it was before the last
+	 * tick and where it is now, by how far we are into the next tick.
+	 */
+	void paint(renderer_t& rend) {
+		rend.clear();
+
+		if (state & STATE_PLAYING) {
+			/* draw player sprite */
+			pt_t pp = ipos(prev.player, player.pt);
+			if (in_cull(pp.x, pp.y, PLAYER_WIDTH, PLAYER_HEIGHT)) {
+				bmap_tex(rend, kTexPlayer);
+				rend.fill_quad(pp.x, pp.y, PLAYER_WIDTH, PLAYER_HEIGHT);
+			}
+
+			if (player.proj.y > 0) {
+				/* draw player projective if needed */
+				pt_t pj = ipos(prev.proj, { player.proj.x, player.proj.y }, prev.proj_on);
+				if (in_cull(pj.x, pj.y, 2, 12))
+					rend.fill_quad(pj.x, pj.y, 2, 12, false, 0, 1, 0);
+			}
+
+			if (state & STATE_MOTHERSHIP)
+				draw_independent_enemy(rend, enemy_mothership, prev.mothership, prev.mothership_on);
+			else {
+				draw_independent_enemy(rend, enemy_destroyer, prev.destroyer, prev.destroyer_on);
+				draw_independent_enemy(rend, enemy_meteor, prev.meteor, prev.meteor_on);
+
+				pt_t anchor = ipos(prev.anchor, enemy_anchor);
+
+				/* draw enemies, straight walk over the grid arrays */
+				for (size_t i = 0; i < grid.size(); i++) {
+					if (!grid.visible[i])
+						continue;
+
+					pt_t rela = grid.cell_pt(i);
+					if (!in_cull(anchor.x + rela.x, anchor.y + rela.y, grid.w, grid.h))
+						continue;
+
+					/* bind preselected texture and draw */
+					bmap_tex(rend, grid.type[i]);
+					rend.fill_quad(anchor.x + rela.x, anchor.y + rela.y, grid.w, grid.h);
+				}
+			}
+
+			/* enemy fire moves at a fixed speed, back it up by what's left of the tick */
+			float back = (1 - alpha) * ENEMY_PROJ_SPEED;
+
+			for (size_t i = 0; i < enemy_projectiles.size(); i++) {
+				if (in_cull(enemy_projectiles.x(i), enemy_projectiles.y(i) - back, 2, 12))
+					rend.fill_quad(enemy_projectiles.x(i), enemy_projectiles.y(i) - back, 2, 12, false, 1, 0, 0);
+			}
+		}
+
+		/* draw status string on top */
+		rend.draw_string(0, 0, hud.status_line(level, lives, points, highscore));
+
+		/* win lose notification strings */
+
+		if (state & STATE_RESUME) {
+			if (has_savegame_file()) {
+				rend.draw_stringm(220,
+								  "Press 'Enter' to start or 's' to load saved game!");
+			}
+			else {
+				rend.draw_stringm(220,
+								  "Press 'Enter' to start!");
+			}
+		}
+		else if (state & STATE_WON) {
+			rend.draw_stringm(200,
+							 "Well done, you won!",
+							 0, 1, 0);
+
+			if (level != MAX_LEVEL)
+				rend.draw_stringm(220,
+								  "Press 'Enter' to go to next level!");
+			else
+				rend.draw_stringm(220,
+								  "Press 'Enter' to try again!");
+		}
+		else if (state & STATE_LOST) {
+			rend.draw_stringm(200,
+							 "You lost, too bad!",
+							 1, 0, 0);
+			rend.draw_stringm(220,
+							  "Press 'Enter' to try again!");
+		}
+		else if (state & STATE_MOTHERSHIP) {
+			rend.draw_string(0, 16, hud.mothership_line(enemy_mothership.lives), 1, 1, 0);
+		}
+	}
+
+	/* this frame's damage becomes the next frame's leftovers */
+	void damage_drawn() {
+		last_damage.clear();
+		last_damage.add(damage);
+		last_damage.full = false;
+
+		damage.clear();
+		hud_drawn = hud.version;
+	}
+
+public:
+	/* where each sprite comes from, NULL for texture ids without one */
+	static void sprite_paths(const char* paths[_kTexEnd]) {
+		std::fill(paths, paths + _kTexEnd, (const char*)NULL);
+
+		/*
+		 * some ugly macros and code to populate the
+		 * tex array for later.
+		 */
+#define T(k, p) paths[k] = "images/" p ".png";
+		T(kTexDestroyer, "destroyer");
+
+		T(kTexMothership, "mothership");
+		T(kTexMartian, "martian");
+		T(kTexMeteor, "meteor");
+		T(kTexPlayer, "Space-invaders");
+		T(kTexVenusian, "venusian");
+		T(kTexMercurian, "mercurian");
+#undef T
+	}
+
+	/*
+	 * take the sprites from the baked pack if there is one with all of
+	 * them in it (see bake.cc), that's just the uploads. otherwise decode
+	 * them all in parallel and hand them to the renderer one by one (GL
+	 * wants to be called from one thread); a sprite that can't be loaded
+	 * shows up as a white box. returns true if the pack was used.
+	 */
+	bool load_textures(renderer_t& rend, const char* pack_path = ASSET_PACK_FILE) {
+		const char* paths[_kTexEnd];
+		sprite_paths(paths);
+
+		if (pack.open(pack_path)) {
+			image_view_t levels[_kTexEnd][PACK_MAX_LEVELS];
+			int n[_kTexEnd] = {};
+			bool complete = true;
+
+			for (int k = 0; k < _kTexEnd; k++) {
+				if (paths[k] && !(n[k] = pack.levels_of(k, levels[k])))
+					complete = false;
+			}
+
+			if (complete) {
+				for (int k = 0; k < _kTexEnd; k++) {
+					if (paths[k])
+						textures[k] = rend.load_texture_levels(levels[k], n[k]);
+				}
+				return true;
+			}
+
+			fprintf(stderr, "%s is missing sprites, rebake it\n", pack_path);
+			pack.close();
+		}
+
+		image_t imgs[_kTexEnd];
+		load_images(paths, _kTexEnd, imgs);
+
+		image_t blank;
+		blank.w = blank.h = 1;
+		blank.px.assign(1, 0xffffffff);
+
+		for (int k = 0; k < _kTexEnd; k++) {
+			if (!paths[k])
+				continue;
+
+			if (!imgs[k].w) {
+				fprintf(stderr, "can't load %s\n", paths[k]);
+				textures[k] = rend.load_texture(blank);
+			}
+			else
+				textures[k] = rend.load_texture(imgs[k]);
+		}
+
+		return false;
+	}
+
+	/* repaint everything */
+	void draw(renderer_t& rend) {
+		paint(rend);
+		rend.end_frame();
+		damage_drawn();
+	}
+
+	/*
+	 * repaint only what changed: the areas the ticks since the last draw
+	 * touched, plus the ones the last draw touched (things drawn there
+	 * were drawn at interpolated positions, which have moved on since).
+	 * the HUD strip is only repainted when its text changed. needs damage
+	 * tracking on and a renderer that keeps its pixels between frames.
+	 */
+	void draw_damaged(renderer_t& rend) {
+		if (!track_damage || damage.full) {
+			draw(rend);
+			return;
+		}
+
+		damage_t area = damage;
+		area.add(last_damage);
+
+		hud.status_line(level, lives, points, highscore);
+		if (state & STATE_MOTHERSHIP)
+			hud.mothership_line(enemy_mothership.lives);
+
+		if (hud.version != hud_drawn)
+			area.add({ { 0, 0 }, surface_w, HUD_HEIGHT });
+
+		/* a pixel of slack for float rounding in the interpolation */
+		culling = true;
+		for (int i = 0; i < area.size(); i++) {
+			const rect_t& r = area[i];
+			rend.set_clip(r.pt.x - 1, r.pt.y - 1, r.w + 2, r.h + 2);
+			cull = { { r.pt.x - 2, r.pt.y - 2 }, r.w + 4, r.h + 4 };
+			paint(rend);
+		}
+		culling = false;
+
+		rend.clear_clip();
+		rend.end_frame();
+		damage_drawn();
+	}
+
+	/* interpolation fraction used by draw(), headless runs leave it at 1 */
+	void set_alpha(float a) {
+		alpha = a;
+	}
+
+	scene_t() : alpha(1), hud_drawn(0), culling(false) {
+		std::fill(textures, textures + _kTexEnd, 0u);
+	}
+	virtual ~scene_t() {}
+};
+
+#endif /* INVADERS_RENDER_H */
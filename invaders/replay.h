@@ -0,0 +1,518 @@
+/*
+ * space invaders game - input recording and replay
+ *
+ * the sim is deterministic: the same seed, highscore and inputs on the
+ * same ticks give the same game, bit for bit. so a run is recorded as
+ * just that, and replayed by feeding the inputs back in at full speed.
+ * to get to tick t without playing everything before it, a full
+ * snapshot (keyframe) is kept every so many ticks:
+ *
+ *   replay_header_t
+ *   events          (count of them, each: varint ticks since the last
+ *                    one, kind byte, one signed arg byte for kInputDelta)
+ *   keyframes       (snapshots, see snapshot.h, 4 byte aligned)
+ *   replay_key_t * n_keys
+ *   replay_trailer_t
+ *
+ * seeking restores the last keyframe at or before t and plays the
+ * inputs from there, so it costs one snapshot load and at most one
+ * keyframe interval of ticks however long the recording is. the index
+ * at the end says where the keyframes are, along with the digest the
+ * sim had at each one so a replay that goes wrong can say roughly where.
+ *
+ * the header ends with the tick the recording stopped at and the sim's
+ * digest there, a replay that doesn't land on both has gone wrong (the
+ * sim changed, or the log is from another build). numbers are in host
+ * byte order.
+ */
+
+#ifndef INVADERS_REPLAY_H
+#define INVADERS_REPLAY_H
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "sim.h"
+#include "snapshot.h"
+#include "mapfile.h"
+
+#define REPLAY_MAGIC "IVRP"
+#define REPLAY_INDEX_MAGIC "IVRX"
+#define REPLAY_VERSION 2
+
+/* 10 seconds of play at the game's tick rate */
+#define REPLAY_KEYFRAME_TICKS 5000
+
+/* the inputs the game takes, see game_t::scan_key */
+enum input_kind_t {
+	kInputDelta = 0,	/* arrow key down/up, arg is the new delta */
+	kInputFire = 1,		/* space or up arrow */
+	kInputEnter = 2,	/* return, next round */
+	_kInputEnd = 3
+};
+
+/*
+ * feed one input to the sim. returns false if it didn't do anything
+ * (enter while a round is on), those don't need recording.
+ */
+inline bool apply_input(sim_t& sim, int kind, int arg) {
+	switch (kind) {
+		case kInputDelta:
+			sim.set_player_delta(arg);
+			return true;
+		case kInputFire:
+			sim.player_fire();
+			return true;
+		case kInputEnter:
+			return sim.reset_if_possible();
+		default:
+			return false;
+	}
+}
+
+struct replay_header_t {
+	char magic[4];
+	uint32_t version;
+
+	/* whole file, header included */
+	uint32_t size;
+
+	/* crc32 of the events */
+	uint32_t crc;
+
+	/* how the sim was set up */
+	uint64_t seed;
+	float surface_w, surface_h;
+	int32_t highscore;
+
+	uint32_t count;
+
+	/* where the recording stopped, and the sim's digest there */
+	uint64_t end_tick;
+	uint64_t digest;
+
+	/* bytes of events right after the header, ticks between keyframes */
+	uint32_t events_size;
+	uint32_t keyframe_every;
+};
+
+/* a keyframe, taken right after tick `tick` (before that boundary's inputs) */
+struct replay_key_t {
+	uint64_t tick;
+	uint64_t digest;
+
+	/* file offset and size of the snapshot */
+	uint32_t off, size;
+
+	/* the first input that comes after it */
+	uint32_t event;
+	uint32_t reserved;
+};
+
+struct replay_trailer_t {
+	uint32_t index_off;
+	uint32_t n_keys;
+
+	/* crc32 of the index */
+	uint32_t crc;
+	char magic[4];
+};
+
+struct replay_event_t {
+	/* applied between ticks, when the sim's tick counter reads this */
+	uint64_t tick;
+	uint8_t kind;
+	int8_t arg;
+};
+
+/***************************************************************
+ * RECORDING
+ ***************************************************************/
+
+/*
+ * collects a run's inputs as they happen. start() it right after the
+ * sim is set up (seed, init, highscore), record() every input, call
+ * after_tick() after every tick for the keyframes and finish() to get
+ * the file. inputs are a few bytes per key press, keyframes a few KB
+ * each.
+ */
+class replay_recorder_t {
+	replay_header_t header;
+	std::vector<uint8_t> events;
+
+	/* snapshots back to back, offsets in keys are into this until finish() */
+	std::vector<uint8_t> keyframes;
+	std::vector<replay_key_t> keys;
+
+	/* reused for every keyframe */
+	sim_capture_t capture;
+	std::vector<uint8_t> snap;
+
+	uint64_t last_tick;
+	int last_delta;
+	bool on;
+
+	void put_varint(uint64_t v) {
+		while (v >= 0x80) {
+			events.push_back(static_cast<uint8_t>(v | 0x80));
+			v >>= 7;
+		}
+		events.push_back(static_cast<uint8_t>(v));
+	}
+
+public:
+	bool is_on() const {
+		return on;
+	}
+
+	void start(sim_t& sim, float w, float h, int highscore, uint32_t keyframe_every = REPLAY_KEYFRAME_TICKS) {
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, REPLAY_MAGIC, 4);
+		header.version = REPLAY_VERSION;
+		header.seed = sim.get_seed();
+		header.surface_w = w;
+		header.surface_h = h;
+		header.highscore = highscore;
+		header.keyframe_every = keyframe_every;
+
+		events.clear();
+		keyframes.clear();
+		keys.clear();
+		last_tick = sim.get_tick();
+		last_delta = 0;
+		on = true;
+	}
+
+	/*
+	 * an input that was just applied to sim (see apply_input). key
+	 * repeat sends the same delta over and over, only changes are kept.
+	 */
+	void record(sim_t& sim, int kind, int arg) {
+		if (!on)
+			return;
+
+		if (kind == kInputDelta) {
+			if (arg == last_delta)
+				return;
+			last_delta = arg;
+		}
+
+		uint64_t t = sim.get_tick();
+		put_varint(t - last_tick);
+		last_tick = t;
+
+		events.push_back(static_cast<uint8_t>(kind));
+		if (kind == kInputDelta)
+			events.push_back(static_cast<uint8_t>(static_cast<int8_t>(arg)));
+
+		header.count++;
+	}
+
+	/* keyframe if it's time, a capture and a snapshot every keyframe_every ticks */
+	void after_tick(sim_t& sim) {
+		uint64_t t = sim.get_tick();
+
+		if (!on || !header.keyframe_every || t % header.keyframe_every)
+			return;
+
+		sim.capture(capture);
+		capture.marshal(snap);
+
+		replay_key_t k = { t, sim.digest(), static_cast<uint32_t>(keyframes.size()),
+						   static_cast<uint32_t>(snap.size()), header.count, 0 };
+		keys.push_back(k);
+		keyframes.insert(keyframes.end(), snap.begin(), snap.end());
+	}
+
+	/* stop and put the whole file in buf, sim is where the run ended */
+	void finish(sim_t& sim, std::vector<uint8_t>& buf) {
+		on = false;
+
+		/* keyframes go on a 4 byte boundary, snapshots are read in place */
+		size_t key_base = (sizeof(header) + events.size() + 3) & ~static_cast<size_t>(3);
+		size_t index_off = key_base + keyframes.size();
+
+		for (replay_key_t& k : keys)
+			k.off += static_cast<uint32_t>(key_base);
+
+		replay_trailer_t tr;
+		tr.index_off = static_cast<uint32_t>(index_off);
+		tr.n_keys = static_cast<uint32_t>(keys.size());
+		tr.crc = snapshot_crc32(reinterpret_cast<const uint8_t*>(keys.data()), keys.size() * sizeof(replay_key_t));
+		memcpy(tr.magic, REPLAY_INDEX_MAGIC, 4);
+
+		header.end_tick = sim.get_tick();
+		header.digest = sim.digest();
+		header.size = static_cast<uint32_t>(index_off + keys.size() * sizeof(replay_key_t) + sizeof(tr));
+		header.crc = snapshot_crc32(events.data(), events.size());
+		header.events_size = static_cast<uint32_t>(events.size());
+
+		buf.assign(header.size, 0);
+
+		uint8_t* p = buf.data();
+		memcpy(p, &header, sizeof(header));
+		memcpy(p + sizeof(header), events.data(), events.size());
+		memcpy(p + key_base, keyframes.data(), keyframes.size());
+		memcpy(p + index_off, keys.data(), keys.size() * sizeof(replay_key_t));
+		memcpy(p + header.size - sizeof(tr), &tr, sizeof(tr));
+
+		keyframes.clear();
+		keys.clear();
+	}
+
+	replay_recorder_t() : last_tick(0), last_delta(0), on(false) {
+		memset(&header, 0, sizeof(header));
+	}
+};
+
+/***************************************************************
+ * PLAYBACK
+ ***************************************************************/
+
+class replay_t {
+	/* the file, keyframes are read out of it when seeking */
+	mapped_file_t file;
+	const uint8_t* base;
+
+	bool load_events(const uint8_t* q, const uint8_t* end, const replay_header_t& h,
+					 std::vector<replay_event_t>& ev) {
+		/* every event is at least two bytes */
+		if (h.count > (end - q) / 2)
+			return false;
+
+		ev.reserve(h.count);
+
+		uint64_t t = 0;
+
+		for (uint32_t i = 0; i < h.count; i++) {
+			uint64_t d = 0;
+			int shift = 0;
+
+			for (;;) {
+				if (q == end || shift > 63)
+					return false;
+
+				uint8_t b = *q++;
+				d |= static_cast<uint64_t>(b & 0x7f) << shift;
+				shift += 7;
+
+				if (!(b & 0x80))
+					break;
+			}
+
+			if (q == end || *q >= _kInputEnd)
+				return false;
+
+			replay_event_t e = { t += d, *q++, 0 };
+
+			if (e.kind == kInputDelta) {
+				if (q == end)
+					return false;
+				e.arg = static_cast<int8_t>(*q++);
+			}
+
+			if (t > h.end_tick)
+				return false;
+
+			ev.push_back(e);
+		}
+
+		return q == end;
+	}
+
+	/*
+	 * the index has to fit between the events and the trailer, and every
+	 * key has to point at a snapshot in the keyframe area and sit
+	 * between the right inputs. the snapshots themselves are checked
+	 * when one is loaded.
+	 */
+	bool load_index(const uint8_t* p, size_t n, const replay_header_t& h,
+					const std::vector<replay_event_t>& ev, std::vector<replay_key_t>& kv) {
+		replay_trailer_t tr;
+		memcpy(&tr, p + n - sizeof(tr), sizeof(tr));
+
+		size_t key_base = sizeof(h) + h.events_size;
+
+		if (memcmp(tr.magic, REPLAY_INDEX_MAGIC, 4) || tr.index_off < key_base || tr.index_off > n - sizeof(tr) ||
+			tr.n_keys > (n - sizeof(tr) - tr.index_off) / sizeof(replay_key_t) ||
+			tr.index_off + tr.n_keys * sizeof(replay_key_t) != n - sizeof(tr))
+			return false;
+
+		if (snapshot_crc32(p + tr.index_off, tr.n_keys * sizeof(replay_key_t)) != tr.crc)
+			return false;
+
+		kv.resize(tr.n_keys);
+		memcpy(kv.data(), p + tr.index_off, tr.n_keys * sizeof(replay_key_t));
+
+		for (uint32_t i = 0; i < tr.n_keys; i++) {
+			const replay_key_t& k = kv[i];
+
+			if (k.off % 4 || k.off < key_base || k.size < sizeof(snap_header_t) ||
+				k.off > tr.index_off || k.size > tr.index_off - k.off)
+				return false;
+
+			if (k.tick > h.end_tick || (i && k.tick <= kv[i-1].tick))
+				return false;
+
+			if (k.event > h.count || (k.event && ev[k.event-1].tick >= k.tick) ||
+				(k.event < h.count && ev[k.event].tick < k.tick))
+				return false;
+		}
+
+		return true;
+	}
+
+	/*
+	 * play from where sim is up to the boundary at tick `to`, inputs
+	 * from events[i] on. like the game, it only ticks while a round is
+	 * on, false if it stops short with no input to get it going again.
+	 */
+	bool run_to(sim_t& sim, size_t& i, uint64_t to) {
+		for (;;) {
+			uint64_t now = sim.get_tick();
+
+			if (now >= to)
+				return now == to;
+
+			for (; i < events.size() && events[i].tick == now; i++)
+				apply_input(sim, events[i].kind, events[i].arg);
+
+			if (!(sim.get_state() & STATE_PLAYING))
+				return false;
+
+			sim.tick();
+		}
+	}
+
+public:
+	replay_header_t header;
+	std::vector<replay_event_t> events;
+	std::vector<replay_key_t> keys;
+
+	/*
+	 * read a recording out of p, which has to stay around for seek().
+	 * the header, inputs and index are checked (magic, version, sizes,
+	 * checksums, inputs that decode to exactly the count given and
+	 * never go past the end tick) before anything's taken.
+	 */
+	bool load(const uint8_t* p, size_t n) {
+		replay_header_t h;
+
+		if (n < sizeof(h) + sizeof(replay_trailer_t))
+			return false;
+
+		memcpy(&h, p, sizeof(h));
+
+		if (memcmp(h.magic, REPLAY_MAGIC, 4) || h.version != REPLAY_VERSION || h.size != n ||
+			h.events_size > n - sizeof(h) - sizeof(replay_trailer_t))
+			return false;
+
+		const uint8_t* q = p + sizeof(h);
+
+		if (snapshot_crc32(q, h.events_size) != h.crc)
+			return false;
+
+		std::vector<replay_event_t> ev;
+		std::vector<replay_key_t> kv;
+
+		if (!load_events(q, q + h.events_size, h, ev) || !load_index(p, n, h, ev, kv))
+			return false;
+
+		header = h;
+		events.swap(ev);
+		keys.swap(kv);
+		base = p;
+		return true;
+	}
+
+	/* same, out of a mapping of path that stays open */
+	bool load(const char* path) {
+		return file.open(path) && load(file.data(), file.size());
+	}
+
+	/* set sim up the way it was when the recording started, false if it can't be */
+	bool start(sim_t& sim) {
+		sim.seed(header.seed);
+		if (!sim.init(header.surface_w, header.surface_h))
+			return false;
+
+		sim.set_highscore(header.highscore);
+		return true;
+	}
+
+	/*
+	 * run a start()ed sim through the whole recording as fast as it
+	 * goes. false if it can't be played through. if a keyframe's
+	 * digest doesn't match on the way, bad_key gets its tick (the
+	 * first one), which puts whatever went wrong in the interval
+	 * before it.
+	 */
+	bool play(sim_t& sim, uint64_t* bad_key = NULL) {
+		size_t i = 0;
+
+		if (bad_key)
+			*bad_key = 0;
+
+		for (const replay_key_t& k : keys) {
+			if (!run_to(sim, i, k.tick))
+				return false;
+
+			if (bad_key && !*bad_key && sim.digest() != k.digest)
+				*bad_key = k.tick;
+		}
+
+		if (!run_to(sim, i, header.end_tick))
+			return false;
+
+		for (; i < events.size(); i++)
+			apply_input(sim, events[i].kind, events[i].arg);
+
+		return true;
+	}
+
+	/*
+	 * put sim where the recording was right after tick `tick`, before
+	 * that boundary's inputs: restore the last keyframe up to there and
+	 * play the rest. from gets the keyframe's tick (0 for none).
+	 */
+	bool seek(sim_t& sim, uint64_t tick, uint64_t* from = NULL) {
+		if (tick > header.end_tick)
+			return false;
+
+		if (!start(sim))
+			return false;
+
+		size_t i = 0;
+
+		/* first key past tick, the one before it is ours */
+		auto k = std::upper_bound(keys.begin(), keys.end(), tick,
+								  [](uint64_t t, const replay_key_t& key) { return t < key.tick; });
+
+		if (k != keys.begin()) {
+			--k;
+
+			if (!sim.unmarshal(base + k->off, k->size) || sim.digest() != k->digest)
+				return false;
+
+			i = k->event;
+		}
+
+		if (from)
+			*from = sim.get_tick();
+
+		return run_to(sim, i, tick);
+	}
+
+	/* did the replay end up exactly where the recording did */
+	bool matches(sim_t& sim) {
+		return sim.get_tick() == header.end_tick && sim.digest() == header.digest;
+	}
+
+	replay_t() : base(NULL) {
+		memset(&header, 0, sizeof(header));
+	}
+};
+
+#endif /* INVADERS_REPLAY_H */
@@ -0,0 +1,2438 @@
+/*
+ * space invaders game - simulation core
+ *
+ * everything that makes the game tick (movement, collisions, spawning,
+ * win/lose) lives here. nothing in this file is allowed to touch GL or
+ * GLUT so the game logic can be stepped without a window, see
+ * headless.cc. the GLUT front end in main.cc is just one consumer.
+ */
+
+#ifndef INVADERS_SIM_H
+#define INVADERS_SIM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "capacity.h"
+#include "snapshot.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/***************************************************************
+ * TYPES AND CONSTANTS FOR THE GAME
+ ***************************************************************/
+
+static int gDifficultyLevels[][2]  = {
+	/* { speed, number_of_cols } */
+	{ 2, 6 },
+	{ 3, 6 },
+	{ 2, 8 },
+	{ 3, 8 }
+};
+
+#define MAX_LEVEL 3
+
+/* rows of aliens in every level, see create_enemies() */
+#define LEVEL_ROWS 3
+
+/* texture IDs */
+enum texture_t {
+	kTexDestroyer = 0,
+	kTexBullet = 1,
+	kTexMothership = 2,
+	kTexMartian = 3,
+	kTexMeteor = 4,
+	kTexPlayer = 5,
+	kTexVenusian = 6,
+	kTexMercurian = 7,
+	_kTexEnd = 8
+};
+
+/* 2d position vector */
+struct pt_t {
+	float x, y;
+};
+/* rectangle */
+struct rect_t {
+	pt_t pt;
+	float w, h;
+};
+
+#define PLAYER_WIDTH 30.0f
+#define PLAYER_HEIGHT 20.0f
+
+/* px per tick while an arrow key is held */
+#define PLAYER_SPEED 4
+
+#define PROJ_WIDTH 2.0f
+#define PROJ_HEIGHT 12.0f
+
+/* px per tick */
+#define PLAYER_PROJ_SPEED 12
+#define ENEMY_PROJ_SPEED 7
+
+#define DIRECTION_RIGHT_TO_LEFT 0
+#define DIRECTION_LEFT_TO_RIGHT 1
+
+#define STATE_PLAYING 0x1
+#define STATE_WON 0x2
+#define STATE_LOST 0x4
+#define STATE_MOTHERSHIP 0x10
+#define STATE_RESUME 0x20
+
+#define AXIS_X 0
+#define AXIS_Y 1
+
+/* chance events, 1 in N per tick */
+#define MEDIUM_ODDS 500
+#define LOW_ODDS 2000
+#define HIGH_ODDS 100
+
+/***************************************************************
+ * STATE DIGEST
+ ***************************************************************/
+
+/*
+ * 64 bit FNV-1a over the bits of the game state, see sim_state_t::digest.
+ * two sims with the same digest are (for all practical purposes) in
+ * the same state, down to the last float bit and rng draw.
+ */
+class state_hash_t {
+	uint64_t h;
+
+public:
+	void add(const void* p, size_t n) {
+		const uint8_t* b = static_cast<const uint8_t*>(p);
+		for (size_t i = 0; i < n; i++) {
+			h ^= b[i];
+			h *= 0x100000001B3ULL;
+		}
+	}
+
+	/* plain values only, no padding */
+	template <typename T>
+	void add(const T& v) {
+		add(&v, sizeof(v));
+	}
+
+	/* the count goes in too so [a][b] and [a, b] differ */
+	template <typename T>
+	void add_array(const T* p, size_t n) {
+		add(static_cast<uint64_t>(n));
+		add(p, n * sizeof(T));
+	}
+
+	uint64_t value() const {
+		return h;
+	}
+
+	state_hash_t() : h(0xCBF29CE484222325ULL) {}
+};
+
+/***************************************************************
+ * RANDOM NUMBERS
+ ***************************************************************/
+
+/*
+ * small, fast PRNG (xoshiro128**). each game owns one so a seeded game
+ * always plays out the same way and games on different threads don't
+ * share (or fight over) global state like rand() does.
+ */
+class rng_t {
+	uint32_t s[4];
+
+	static inline uint32_t rotl(uint32_t x, int k) {
+		return (x << k) | (x >> (32 - k));
+	}
+
+public:
+	/* expand a 64 bit seed into the full state with splitmix64 */
+	void seed(uint64_t v) {
+		for (int i = 0; i < 4; i += 2) {
+			uint64_t z = (v += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			z ^= z >> 31;
+
+			s[i] = static_cast<uint32_t>(z);
+			s[i+1] = static_cast<uint32_t>(z >> 32);
+		}
+	}
+
+	uint32_t next() {
+		uint32_t r = rotl(s[1] * 5, 7) * 9;
+		uint32_t t = s[1] << 9;
+
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 11);
+
+		return r;
+	}
+
+	/* uniform in [0, n), no modulo bias */
+	uint32_t below(uint32_t n) {
+		uint64_t m = (uint64_t)next() * n;
+		uint32_t l = static_cast<uint32_t>(m);
+
+		if (l < n) {
+			uint32_t t = -n % n;
+			while (l < t) {
+				m = (uint64_t)next() * n;
+				l = static_cast<uint32_t>(m);
+			}
+		}
+		return static_cast<uint32_t>(m >> 32);
+	}
+
+	/* true with probability 1/n */
+	bool one_in(uint32_t n) {
+		return below(n) == 0;
+	}
+
+	/*
+	 * batch bernoulli: how many 1-in-n trials fail before the next one
+	 * succeeds (geometric distribution). walking a list with this gives
+	 * the same result as rolling for every element, with one draw per
+	 * success instead of one per element.
+	 */
+	size_t skip(uint32_t n) {
+		if (n <= 1)
+			return 0;
+
+		/* u in (0, 1] so the log is finite */
+		double u = (next() + 1.0) * (1.0 / 4294967296.0);
+		return static_cast<size_t>(log(u) / log1p(-1.0 / n));
+	}
+
+	void hash(state_hash_t& h) const {
+		h.add(s);
+	}
+
+	void marshal(uint32_t out[4]) const {
+		std::copy(s, s + 4, out);
+	}
+
+	void unmarshal(const uint32_t in[4]) {
+		std::copy(in, in + 4, s);
+	}
+
+	rng_t() {
+		seed(0);
+	}
+};
+
+/***************************************************************
+ * EVENT SCHEDULER
+ ***************************************************************/
+
+/* per-alien events, kept in the heap */
+enum event_kind_t {
+	kEvGridFire = 0,
+	kEvGridCloak = 1
+};
+
+/* one-off chances for the special enemies, kept in a fixed table */
+enum chance_t {
+	kChanceMeteor = 0,
+	kChanceDestroyer = 1,
+	kChanceMothershipFire = 2,
+	kChanceDestroyerCloak = 3,
+	_kChanceEnd = 4
+};
+
+static_assert(_kChanceEnd == SNAPSHOT_CHANCES, "snapshot chance table is out of date");
+
+struct event_t {
+	uint64_t due;
+	int slot;
+	int kind;
+
+	/* min-heap on due tick */
+	bool operator> (const event_t& o) const {
+		return due > o.due;
+	}
+};
+
+/*
+ * schedule for the random 1-in-N events. rolling a die every tick for
+ * every alien is wasteful when almost none of the rolls come up, so
+ * instead the number of ticks until the next success is drawn once
+ * (rng_t::skip gives exactly the same distribution) and the event is
+ * parked until then. per-tick cost is down to the events that actually
+ * happen.
+ *
+ * ticks are counted from 1, a due tick of 0 means nothing's scheduled.
+ * the heap holds up to MaxEvents.
+ */
+template <size_t MaxEvents>
+class scheduler_t {
+	event_t heap[MaxEvents];
+	size_t n;
+	uint64_t due[_kChanceEnd];
+	uint32_t due_odds[_kChanceEnd];
+
+public:
+	void clear() {
+		n = 0;
+		std::fill(due, due + _kChanceEnd, (uint64_t)0);
+		std::fill(due_odds, due_odds + _kChanceEnd, 0u);
+	}
+
+	/* first roll happens at tick `from`, returns false (and drops it) if the heap is full */
+	bool push(uint64_t from, int slot, int kind, uint32_t odds, rng_t& rng) {
+		if (n == MaxEvents)
+			return false;
+
+		event_t e = { from + rng.skip(odds), slot, kind };
+
+		heap[n++] = e;
+		std::push_heap(heap, heap + n, std::greater<event_t>());
+		return true;
+	}
+
+	/* is there an event due at (or, if we missed it, before) now */
+	bool pending(uint64_t now) {
+		return n && heap[0].due <= now;
+	}
+
+	event_t pop() {
+		std::pop_heap(heap, heap + n, std::greater<event_t>());
+		return heap[--n];
+	}
+
+	/*
+	 * stand-in for rolling a 1-in-odds die for chance c this tick, for
+	 * things that only roll while some condition holds (e.g. a meteor
+	 * spawn only while there's no meteor). call it on exactly the ticks
+	 * where the die would have been rolled.
+	 *
+	 * the draw is only thrown away if its tick went by without a roll
+	 * (i.e. while the condition didn't hold) or the odds changed. since
+	 * the distribution is memoryless, drawing afresh from the next roll
+	 * on is exact.
+	 */
+	bool roll(int c, uint64_t now, uint32_t odds, rng_t& rng) {
+		if (due[c] < now || due_odds[c] != odds) {
+			due[c] = now + rng.skip(odds);
+			due_odds[c] = odds;
+		}
+
+		if (due[c] != now)
+			return false;
+
+		due[c] = now + 1 + rng.skip(odds);
+		return true;
+	}
+
+	/* heap order included, it decides which of two same-tick events runs first */
+	void hash(state_hash_t& h) const {
+		h.add(static_cast<uint64_t>(n));
+		for (size_t i = 0; i < n; i++) {
+			const event_t& e = heap[i];
+			h.add(e.due);
+			h.add(e.slot);
+			h.add(e.kind);
+		}
+		h.add(due);
+		h.add(due_odds);
+	}
+
+	/* heap array as it is, a restored scheduler pops in the same order */
+	void marshal(snap_run_t& r, std::vector<snap_event_t>& ev) const {
+		for (int c = 0; c < _kChanceEnd; c++) {
+			r.due[c].set(due[c]);
+			r.due_odds[c] = due_odds[c];
+		}
+
+		ev.resize(n);
+		for (size_t i = 0; i < n; i++) {
+			ev[i].due.set(heap[i].due);
+			ev[i].slot = heap[i].slot;
+			ev[i].kind = heap[i].kind;
+		}
+	}
+
+	/* ev has to be a valid heap that fits, see basic_sim_state_t::unmarshal */
+	void unmarshal(const snap_run_t& r, const snap_event_t* ev, size_t count) {
+		for (int c = 0; c < _kChanceEnd; c++) {
+			due[c] = r.due[c].get();
+			due_odds[c] = r.due_odds[c];
+		}
+
+		n = count;
+		for (size_t i = 0; i < n; i++) {
+			event_t e = { ev[i].due.get(), ev[i].slot, ev[i].kind };
+			heap[i] = e;
+		}
+	}
+
+	scheduler_t() {
+		clear();
+	}
+};
+
+/***************************************************************
+ * PROJECTILES
+ ***************************************************************/
+
+struct projectile_t {
+	float x, y;
+
+	/*
+	 * collision detection:
+	 *   test this projectile against a rect
+	 */
+	bool test(rect_t rect) {
+		return (this->x <= (rect.pt.x + rect.w) &&
+				rect.pt.x <= (this->x + PROJ_WIDTH) &&
+				this->y <= (rect.pt.y + rect.h) &&
+				rect.pt.y <= (this->y + PROJ_HEIGHT));
+	}
+
+	void deact() {
+		y = -1;
+	}
+};
+
+/*
+ * fixed capacity pool of projectiles that all move the same way (enemy
+ * fire). positions live in separate x/y arrays so the per-tick advance,
+ * off-screen cull and hit-test against the player can run several
+ * projectiles per instruction. removal is swap-with-last so the arrays
+ * stay packed and order isn't preserved. a full pool drops shots.
+ */
+template <size_t PoolSize>
+class projectile_pool_t {
+	static_assert(PoolSize <= 65536, "kill list slots are 16 bit");
+
+	float xs[PoolSize];
+	float ys[PoolSize];
+	size_t n;
+
+	/* slots to remove after an advance, ascending */
+	uint16_t kill[PoolSize];
+	size_t nkill;
+
+	/* record dead lanes of a block starting at slot i */
+	inline void mark(size_t i, unsigned bits) {
+		while (bits) {
+			kill[nkill++] = static_cast<uint16_t>(i + __builtin_ctz(bits));
+			bits &= bits - 1;
+		}
+	}
+
+public:
+	size_t size() {
+		return n;
+	}
+
+	float x(size_t i) {
+		return xs[i];
+	}
+
+	float y(size_t i) {
+		return ys[i];
+	}
+
+	/* add a projectile, returns false (and drops it) if the pool is full */
+	bool spawn(float x, float y) {
+		if (n == PoolSize)
+			return false;
+
+		xs[n] = x;
+		ys[n] = y;
+		n++;
+		return true;
+	}
+
+	void clear() {
+		n = 0;
+	}
+
+	/*
+	 * one tick for every projectile: anything touching `target` is
+	 * removed and counted as a hit, anything past `bound` is removed,
+	 * everything else moves down by dy. returns the number of hits.
+	 */
+	int advance(float dy, float bound, rect_t target) {
+		int hits = 0;
+		size_t i = 0;
+
+		nkill = 0;
+
+#if defined(__AVX2__)
+		const __m256 tx0 = _mm256_set1_ps(target.pt.x), tx1 = _mm256_set1_ps(target.pt.x + target.w);
+		const __m256 ty0 = _mm256_set1_ps(target.pt.y), ty1 = _mm256_set1_ps(target.pt.y + target.h);
+		const __m256 pw = _mm256_set1_ps(PROJ_WIDTH), ph = _mm256_set1_ps(PROJ_HEIGHT);
+		const __m256 vb = _mm256_set1_ps(bound), vdy = _mm256_set1_ps(dy);
+
+		for (; i + 8 <= n; i += 8) {
+			__m256 x = _mm256_loadu_ps(xs + i), y = _mm256_loadu_ps(ys + i);
+
+			/* same comparisons as projectile_t::test */
+			__m256 hit = _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(x, tx1, _CMP_LE_OQ), _mm256_cmp_ps(tx0, _mm256_add_ps(x, pw), _CMP_LE_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(y, ty1, _CMP_LE_OQ), _mm256_cmp_ps(ty0, _mm256_add_ps(y, ph), _CMP_LE_OQ)));
+			__m256 off = _mm256_cmp_ps(y, vb, _CMP_GT_OQ);
+
+			unsigned hbits = _mm256_movemask_ps(hit);
+			hits += __builtin_popcount(hbits);
+
+			/* dead lanes get moved too, they're about to be overwritten */
+			_mm256_storeu_ps(ys + i, _mm256_add_ps(y, vdy));
+			mark(i, hbits | _mm256_movemask_ps(off));
+		}
+#elif defined(__SSE2__)
+		const __m128 tx0 = _mm_set1_ps(target.pt.x), tx1 = _mm_set1_ps(target.pt.x + target.w);
+		const __m128 ty0 = _mm_set1_ps(target.pt.y), ty1 = _mm_set1_ps(target.pt.y + target.h);
+		const __m128 pw = _mm_set1_ps(PROJ_WIDTH), ph = _mm_set1_ps(PROJ_HEIGHT);
+		const __m128 vb = _mm_set1_ps(bound), vdy = _mm_set1_ps(dy);
+
+		for (; i + 4 <= n; i += 4) {
+			__m128 x = _mm_loadu_ps(xs + i), y = _mm_loadu_ps(ys + i);
+
+			/* same comparisons as projectile_t::test */
+			__m128 hit = _mm_and_ps(
+				_mm_and_ps(_mm_cmple_ps(x, tx1), _mm_cmple_ps(tx0, _mm_add_ps(x, pw))),
+				_mm_and_ps(_mm_cmple_ps(y, ty1), _mm_cmple_ps(ty0, _mm_add_ps(y, ph))));
+			__m128 off = _mm_cmpgt_ps(y, vb);
+
+			unsigned hbits = _mm_movemask_ps(hit);
+			hits += __builtin_popcount(hbits);
+
+			/* dead lanes get moved too, they're about to be overwritten */
+			_mm_storeu_ps(ys + i, _mm_add_ps(y, vdy));
+			mark(i, hbits | _mm_movemask_ps(off));
+		}
+#endif
+
+		/* scalar tail (or everything, without SIMD) */
+		for (; i < n; i++) {
+			projectile_t p = { xs[i], ys[i] };
+
+			if (p.test(target)) {
+				hits++;
+				mark(i, 1);
+			}
+			else if (p.y > bound) {
+				mark(i, 1);
+			}
+
+			ys[i] += dy;
+		}
+
+		/*
+		 * swap-remove from the back so whatever gets moved into a
+		 * dead slot is always a live projectile
+		 */
+		while (nkill) {
+			size_t k = kill[--nkill];
+
+			n--;
+			xs[k] = xs[n];
+			ys[k] = ys[n];
+		}
+
+		return hits;
+	}
+
+	/* live slots only, whatever is past n is garbage */
+	void hash(state_hash_t& h) const {
+		h.add(static_cast<uint64_t>(n));
+		h.add(xs, n * sizeof(float));
+		h.add(ys, n * sizeof(float));
+	}
+
+	void marshal(std::vector<snap_projectile_t>& out) const {
+		out.resize(n);
+		for (size_t i = 0; i < n; i++) {
+			out[i].x = xs[i];
+			out[i].y = ys[i];
+		}
+	}
+
+	/* count has to fit, see basic_sim_state_t::unmarshal */
+	void unmarshal(const snap_projectile_t* p, size_t count) {
+		n = count;
+		for (size_t i = 0; i < n; i++) {
+			xs[i] = p[i].x;
+			ys[i] = p[i].y;
+		}
+	}
+
+	projectile_pool_t() : n(0), nkill(0) {
+		std::fill(xs, xs + PoolSize, 0.0f);
+		std::fill(ys, ys + PoolSize, 0.0f);
+	}
+};
+
+/***************************************************************
+ * ABSTRACT ENEMIES
+ ***************************************************************/
+
+
+/*
+ * c++ doesn't have abstracts per se, if a class has at least one
+ * pure virtual fn, it's "abstract".
+ */
+class enemy_t {
+protected:
+	/*
+	 * texture ID, used as an "image" for drawing the thing (each
+	 * texture ID corresponds to a loaded image mapped out in the
+	 * game class)
+	 */
+	texture_t tex;
+	int points;
+
+	/* pure virtuals */
+	virtual pt_t get_pt() = 0;
+
+	enemy_t(texture_t t, int pts) {
+		tex = t;
+		points = pts;
+		visible = false;
+		active = false;
+		w = 30; h = 20;
+	}
+
+public:
+	bool active;
+	bool visible;
+	float w, h;
+
+	virtual ~enemy_t() {}
+
+	virtual void act() {
+		active = visible = true;
+	}
+
+	void deact() {
+		visible = false;
+		active = false;
+	}
+
+	int die() {
+		deact();
+		return points;
+	}
+
+	bool is_visible() {
+		return visible;
+	}
+
+	texture_t get_texture_id() {
+		return tex;
+	}
+
+	/* points awarded for killing this enemy */
+	int die_points() {
+		return points;
+	}
+
+	void marshal(snap_enemy_t& r) {
+		r.tex = tex;
+		r.points = points;
+		r.visible = visible;
+		r.active = active;
+		r.pad[0] = r.pad[1] = 0;
+		r.w = w;
+		r.h = h;
+	}
+
+	void unmarshal(const snap_enemy_t& r) {
+		/* omit tex as that's used to construct the object */
+		points = r.points;
+		visible = r.visible != 0;
+		active = r.active != 0;
+		w = r.w;
+		h = r.h;
+	}
+};
+
+/* independent enemy (moves on its own) */
+class e_independent_t : public enemy_t {
+	int axis;
+
+protected:
+	int dir;
+	int max_lives;
+	float speed_factor;
+
+public:
+	pt_t pos;
+	int lives;
+
+	virtual pt_t get_pt() override {
+		return pos;
+	}
+
+	virtual bool bounce() {
+		return false;
+	}
+
+	/*
+	 * advance a single, standalone enemy. this can be implemented
+	 * here as it relies on very little global state unlike anchored
+	 * aliens. returns if we updated the scene or not.
+	 */
+	bool advance(int speed, float g_w, float g_h) {
+		/* constaints and reference for the update */
+		float& u_pt    = axis == AXIS_X ? pos.x : pos.y;
+		float  u_bound = axis == AXIS_X ? g_w : g_h;
+		float  u_size  = axis == AXIS_X ? w : h;
+
+		speed *= speed_factor;
+
+		if (dir == DIRECTION_RIGHT_TO_LEFT)
+			speed = -speed;
+
+		/*
+		 * check that we fall within the constraint. if we do,
+		 * move us, if we don't, call bounce and let the subclass
+		 * handle it.
+		 */
+		if (((u_pt+speed < 0) || (u_pt+speed+u_size > u_bound)) && bounce()) {
+			return false;
+		}
+		else {
+			/* advance by speed */
+			u_pt += speed;
+			return true;
+		}
+	}
+
+	/*
+	 * test a (player's) projectile against this enemy.
+	 * returns: positive value if died, 0 if miss, -1 if hit but life lost.
+	 */
+	int collide(projectile_t& proj) {
+		/* make sure the projectile is active */
+		if (proj.y <= 0)
+			return 0;
+
+		/* create rect representing this enemy */
+		rect_t r = {pos, w, h};
+
+		/* perform collision detection against the projectile */
+		if (proj.test(r)) {
+			/*
+			 * we've been hit. if we're now at 0 lives, die, otherwise
+			 * do nothing and return 0 points.
+			 */
+			proj.deact();
+			if(!--lives) {
+				die();
+				return points;
+			}
+		}
+		return 0;
+	}
+
+	virtual void act() override {
+		enemy_t::act();
+		lives = max_lives;
+	}
+
+	void marshal(snap_independent_t& r) {
+		enemy_t::marshal(r.base);
+		r.axis = axis;
+		r.dir = dir;
+		r.speed_factor = speed_factor;
+		r.lives = lives;
+		r.max_lives = max_lives;
+		r.x = pos.x;
+		r.y = pos.y;
+	}
+
+	void unmarshal(const snap_independent_t& r) {
+		enemy_t::unmarshal(r.base);
+		axis = r.axis;
+		dir = r.dir;
+		speed_factor = r.speed_factor;
+		lives = r.lives;
+		max_lives = r.max_lives;
+		pos.x = r.x;
+		pos.y = r.y;
+	}
+
+protected:
+	e_independent_t(texture_t t, int pts, int a) : enemy_t(t, pts) {
+		axis = a;
+		dir = DIRECTION_LEFT_TO_RIGHT;
+		max_lives = 1;
+		speed_factor = 1;
+
+		/* not used until act(), but part of the state (digest, snapshots) */
+		pos = { 0, 0 };
+		lives = 0;
+	}
+};
+
+/* anchored enemy (moves relative to others) */
+class e_anchored_t : public enemy_t {
+public:
+	int grid_row, grid_col;
+
+	virtual pt_t get_pt() override {
+		return {
+			grid_col * w + (grid_col * 10) /* spacing */,
+			grid_row * h
+		};
+	}
+
+	void marshal(snap_anchored_t& r) {
+		enemy_t::marshal(r.base);
+		r.col = grid_col;
+		r.row = grid_row;
+	}
+
+	void unmarshal(const snap_anchored_t& r) {
+		enemy_t::unmarshal(r.base);
+		grid_col = r.col;
+		grid_row = r.row;
+	}
+
+	/* defined after all the enemies, NULL if t isn't a grid alien */
+	static e_anchored_t* make(texture_t t);
+
+	virtual ~e_anchored_t() {}
+
+protected:
+	e_anchored_t(texture_t t, int pts) : enemy_t(t, pts) {}
+};
+
+/*
+ * interfaces (not really, but c++ has multiple inheritance)
+ */
+
+/* thing can fire */
+class e_fireable_t {
+
+	/* RTTI */
+public:
+	virtual ~e_fireable_t() {}
+};
+/* thing can cloak */
+class e_cloakable_t {
+
+	/* RTTI */
+public:
+	virtual ~e_cloakable_t() {}
+};
+
+/***************************************************************
+ * CONCRETE ENEMIES
+ ***************************************************************/
+
+/* can fire back at the player. 30 points. */
+class e_martian_t : public e_anchored_t, public virtual e_fireable_t {
+public:
+	e_martian_t() : e_anchored_t(kTexMartian, 30) {}
+	virtual ~e_martian_t() {}
+};
+
+/* can cloak at random times. 40 points. */
+class e_mercurian_t : public e_anchored_t, public virtual e_cloakable_t {
+public:
+	e_mercurian_t() : e_anchored_t(kTexMercurian, 40) {}
+	virtual ~e_mercurian_t() {}
+};
+
+/* 20 points. */
+class e_venusian_t : public e_anchored_t {
+public:
+	e_venusian_t() : e_anchored_t(kTexVenusian, 20) {}
+};
+
+/* */
+class e_destroyer_t : public e_independent_t, public e_cloakable_t {
+public:
+	e_destroyer_t() : e_independent_t(kTexDestroyer, 200, AXIS_X) {
+		w = 50;
+		h = 34;
+		max_lives = 2;
+		speed_factor = 0.5;
+	}
+};
+
+/* */
+class e_mothership_t : public e_independent_t, public e_fireable_t {
+public:
+	e_mothership_t() : e_independent_t(kTexMothership, 100, AXIS_X) {
+		max_lives = 3;
+		speed_factor = 0.5;
+		w = 50;
+		h = 34;
+	}
+
+	/*
+	 * mothership's direction reverses and speed increases
+	 * on bounce.
+	 */
+	virtual bool bounce() override {
+		dir = !dir;
+		speed_factor += 0.3;
+		pos.y += 20;
+		return true;
+	}
+};
+
+/* */
+class e_meteor_t : public e_independent_t {
+public:
+	e_meteor_t() : e_independent_t(kTexMeteor, 100, AXIS_Y) {
+		w = 40;
+		h = 40;
+	}
+};
+
+/* player has to be a class (i think?) */
+class player_t {
+public:
+	/* player position vector */
+	projectile_t proj;
+
+	/* projectile */
+	pt_t pt;
+
+	player_t() {
+		proj.x = 0;
+		proj.y = -1;
+		pt = { 0, 0 };
+	}
+};
+
+/***************************************************************
+ * ENEMY GRID
+ ***************************************************************/
+
+/*
+ * packed storage for the anchored enemies. every per-enemy field gets
+ * its own contiguous array (indexed by the enemy's slot) so the per-tick
+ * loops just stream through memory instead of chasing a pointer and a
+ * vtable per alien. all grid aliens share a cell size.
+ *
+ * the arrays are fixed size (MaxCols x MaxRows cells) and live inside
+ * the grid, so the grid, and the sim around it, copies as one flat block.
+ *
+ * the e_anchored_t subclasses are only used to build aliens. what an
+ * alien can do (fire, cloak) is worked out once when it's added and
+ * kept as lists of slots, so the per-tick pass never needs RTTI.
+ *
+ * the grid also keeps a count of live aliens per column and per row,
+ * updated as they die, so the extent of what's left is known without
+ * looking at every alien. a (col, row) -> slot lookup table lets
+ * hit-tests go straight to the cells a projectile overlaps.
+ */
+template <int MaxCols, int MaxRows>
+class enemy_grid_t {
+	enum { kMaxAliens = MaxCols * MaxRows };
+
+	int n;
+
+public:
+	int col[kMaxAliens], row[kMaxAliens];
+	uint8_t active[kMaxAliens], visible[kMaxAliens];
+	texture_t type[kMaxAliens];
+	int points[kMaxAliens];
+
+	/* slots of the aliens that can fire/cloak */
+	int fireable[kMaxAliens], cloakable[kMaxAliens];
+	int n_fireable, n_cloakable;
+
+	/* cell size */
+	float w, h;
+
+private:
+	/* live aliens per column/row and the live range they span */
+	int col_alive[MaxCols], row_alive[MaxRows];
+	int alive;
+	int min_col, max_col, max_row;
+
+	void count_alive(size_t i) {
+		int c = col[i], r = row[i];
+
+		col_alive[c]++;
+		row_alive[r]++;
+
+		if (!alive++) {
+			min_col = max_col = c;
+			max_row = r;
+		}
+		else {
+			min_col = std::min(min_col, c);
+			max_col = std::max(max_col, c);
+			max_row = std::max(max_row, r);
+		}
+	}
+
+	/*
+	 * drop a dead alien from the counters. edges only ever move
+	 * inwards so the scans here add up to at most one pass over
+	 * the columns/rows for the whole round.
+	 */
+	void uncount_alive(size_t i) {
+		col_alive[col[i]]--;
+		row_alive[row[i]]--;
+
+		if (!--alive)
+			return;
+
+		while (!col_alive[min_col]) min_col++;
+		while (!col_alive[max_col]) max_col--;
+		while (!row_alive[max_row]) max_row--;
+	}
+
+	/* slot index for each cell (row major), -1 for empty cells */
+	int cells[kMaxAliens];
+
+	void reset_alive() {
+		std::fill(col_alive, col_alive + MaxCols, 0);
+		std::fill(row_alive, row_alive + MaxRows, 0);
+		alive = 0;
+		min_col = max_col = max_row = 0;
+	}
+
+public:
+	size_t size() {
+		return n;
+	}
+
+	/* number of live aliens */
+	int count() {
+		return alive;
+	}
+
+	/* (c, r) is a cell of the grid */
+	static bool fits(int c, int r) {
+		return c >= 0 && c < MaxCols && r >= 0 && r < MaxRows;
+	}
+
+	/* nobody in cell (c, r) yet, c and r have to fit() */
+	bool empty(int c, int r) {
+		return cells[r * MaxCols + c] < 0;
+	}
+
+	/*
+	 * bounding box of the live aliens relative to the anchor. an empty
+	 * grid has a zero sized box sitting on the anchor.
+	 */
+	rect_t extent() {
+		if (!alive)
+			return { {0, 0}, 0, 0 };
+
+		float l = min_col * (w + 10);
+
+		return {
+			{ l, 0 },
+			max_col * (w + 10) + w - l,
+			(max_row + 1) * h
+		};
+	}
+
+	/*
+	 * add an alien, copying its fields out of the object. returns false
+	 * (and adds nothing) if its cell is outside the grid or taken.
+	 */
+	bool push(e_anchored_t& e) {
+		if (!fits(e.grid_col, e.grid_row) || !empty(e.grid_col, e.grid_row))
+			return false;
+
+		texture_t t = e.get_texture_id();
+		int i = n++;
+
+		col[i] = e.grid_col;
+		row[i] = e.grid_row;
+		active[i] = e.active;
+		visible[i] = e.visible;
+		type[i] = t;
+		points[i] = e.die_points();
+
+		w = e.w;
+		h = e.h;
+
+		cells[row[i] * MaxCols + col[i]] = i;
+
+		if (e.active)
+			count_alive(i);
+
+		/* capabilities are fixed per alien so look them up once */
+		if (dynamic_cast<e_fireable_t*>(&e))
+			fireable[n_fireable++] = i;
+		if (dynamic_cast<e_cloakable_t*>(&e))
+			cloakable[n_cloakable++] = i;
+
+		return true;
+	}
+
+	/* position of an alien relative to the grid's anchor */
+	inline pt_t cell_pt(size_t i) {
+		return {
+			col[i] * w + (col[i] * 10) /* spacing */,
+			row[i] * h
+		};
+	}
+
+	/*
+	 * find a live alien hit by a projectile, returns its slot or -1.
+	 * the grid is a regular lattice so the projectile's rect (relative
+	 * to the anchor) maps to a small range of cells, at most two per
+	 * axis; only those get the exact test.
+	 */
+	int find_hit(projectile_t& p, pt_t anchor) {
+		float pitch = w + 10;
+		float px = p.x - anchor.x, py = p.y - anchor.y;
+
+		/* floor on the low side may let in one cell too many, the exact test sorts it out */
+		int c0 = std::max(0, (int)floorf((px - w) / pitch));
+		int c1 = std::min(MaxCols - 1, (int)floorf((px + PROJ_WIDTH) / pitch));
+		int r0 = std::max(0, (int)floorf((py - h) / h));
+		int r1 = std::min(MaxRows - 1, (int)floorf((py + PROJ_HEIGHT) / h));
+
+		for (int c = c0; c <= c1; c++) {
+			for (int r = r0; r <= r1; r++) {
+				int i = cells[r * MaxCols + c];
+
+				if (i < 0 || !active[i])
+					continue;
+
+				pt_t rela = cell_pt(i);
+				rect_t rect = { { anchor.x + rela.x, anchor.y + rela.y }, w, h };
+
+				if (p.test(rect))
+					return i;
+			}
+		}
+
+		return -1;
+	}
+
+	void act_all() {
+		std::fill(active, active + n, 1);
+		std::fill(visible, visible + n, 1);
+
+		reset_alive();
+		for (int i = 0; i < n; i++)
+			count_alive(i);
+	}
+
+	int die(size_t i) {
+		if (active[i])
+			uncount_alive(i);
+
+		active[i] = visible[i] = 0;
+		return points[i];
+	}
+
+	void clear() {
+		n = 0;
+		n_fireable = n_cloakable = 0;
+
+		reset_alive();
+		std::fill(cells, cells + kMaxAliens, -1);
+	}
+
+	/* the rest (counters, lookup table, capability lists) follows from these */
+	void hash(state_hash_t& hs) const {
+		hs.add_array(col, n);
+		hs.add_array(row, n);
+		hs.add_array(active, n);
+		hs.add_array(visible, n);
+		hs.add_array(type, n);
+		hs.add_array(points, n);
+		hs.add(w);
+		hs.add(h);
+	}
+
+	enemy_grid_t() : w(30), h(20) {
+		clear();
+	}
+};
+
+/***************************************************************
+ * SERIALIZATION
+ ***************************************************************/
+
+/*
+ * construct a grid alien from the tex property
+ */
+e_anchored_t* e_anchored_t::make(texture_t t) {
+	e_anchored_t* e;
+
+#define Map(x,y) case x: e = new y(); break;
+	switch (t) {
+		Map(kTexMartian, e_martian_t)
+		Map(kTexVenusian, e_venusian_t)
+		Map(kTexMercurian, e_mercurian_t)
+		default: e = NULL;
+	}
+#undef Map
+
+	return e;
+}
+
+/*
+ * everything a snapshot holds, copied out of a sim (basic_sim_state_t::capture) at
+ * a tick boundary. that's a few fixed records plus one copy per grid
+ * array, the event heap and the shots in flight, the vectors keep their
+ * capacity between captures. turning it into a snapshot (records,
+ * checksum) is marshal(), which doesn't need the sim and can run on
+ * another thread.
+ */
+struct sim_capture_t {
+	snap_game_t game;
+	snap_run_t run;
+	snap_independent_t independent[3];
+	std::vector<snap_event_t> events;
+	std::vector<snap_projectile_t> projectiles;
+
+	/* the grid's arrays, see enemy_grid_t */
+	std::vector<int> col, row, points;
+	std::vector<uint8_t> active, visible;
+	std::vector<texture_t> type;
+	float w, h;
+
+	void marshal(std::vector<uint8_t>& buf) const {
+		snapshot_view_t v;
+		v.layout(buf, 3, static_cast<uint32_t>(col.size()),
+				 static_cast<uint32_t>(events.size()), static_cast<uint32_t>(projectiles.size()));
+
+		*v.game = game;
+		*v.run = run;
+		std::copy(independent, independent + 3, v.independent);
+		std::copy(events.begin(), events.end(), v.events);
+		std::copy(projectiles.begin(), projectiles.end(), v.projectiles);
+
+		/* same record as e_anchored_t::marshal */
+		for (size_t i = 0; i < col.size(); i++) {
+			snap_anchored_t& r = v.anchored[i];
+			r.base.tex = type[i];
+			r.base.points = points[i];
+			r.base.visible = visible[i];
+			r.base.active = active[i];
+			r.base.w = w;
+			r.base.h = h;
+			r.col = col[i];
+			r.row = row[i];
+		}
+
+		v.seal();
+	}
+};
+
+/***************************************************************
+ * DAMAGE TRACKING
+ ***************************************************************/
+
+inline bool rect_empty(const rect_t& r) {
+	return r.w <= 0 || r.h <= 0;
+}
+
+inline rect_t rect_union(const rect_t& a, const rect_t& b) {
+	float x0 = std::min(a.pt.x, b.pt.x), y0 = std::min(a.pt.y, b.pt.y);
+	float x1 = std::max(a.pt.x + a.w, b.pt.x + b.w), y1 = std::max(a.pt.y + a.h, b.pt.y + b.h);
+	return { { x0, y0 }, x1 - x0, y1 - y0 };
+}
+
+/* overlapping or sharing an edge */
+inline bool rect_touches(const rect_t& a, const rect_t& b) {
+	return a.pt.x <= b.pt.x + b.w && b.pt.x <= a.pt.x + a.w &&
+		   a.pt.y <= b.pt.y + b.h && b.pt.y <= a.pt.y + a.h;
+}
+
+/* a and b if they're both there, whichever one is otherwise */
+inline rect_t rect_span(bool a_on, const rect_t& a, bool b_on, const rect_t& b) {
+	if (a_on && b_on)
+		return rect_union(a, b);
+	if (a_on)
+		return a;
+	if (b_on)
+		return b;
+	return { { 0, 0 }, 0, 0 };
+}
+
+#define DAMAGE_MAX_RECTS 16
+
+/*
+ * screen areas that changed since the last time somebody drew. a rect
+ * touching one we already have grows that one, and once we're out of
+ * slots it goes into whichever one grows the least, so it only ever
+ * gets coarser. `full` means forget the rects and repaint everything.
+ */
+class damage_t {
+	rect_t rects[DAMAGE_MAX_RECTS];
+	int n;
+
+public:
+	bool full;
+
+	void add(const rect_t& r) {
+		if (rect_empty(r))
+			return;
+
+		for (int i = 0; i < n; i++) {
+			if (rect_touches(rects[i], r)) {
+				rects[i] = rect_union(rects[i], r);
+				return;
+			}
+		}
+
+		if (n < DAMAGE_MAX_RECTS) {
+			rects[n++] = r;
+			return;
+		}
+
+		int best = 0;
+		float best_growth = INFINITY;
+
+		for (int i = 0; i < n; i++) {
+			rect_t u = rect_union(rects[i], r);
+			float growth = u.w * u.h - rects[i].w * rects[i].h;
+
+			if (growth < best_growth) {
+				best_growth = growth;
+				best = i;
+			}
+		}
+
+		rects[best] = rect_union(rects[best], r);
+	}
+
+	void add(const damage_t& d) {
+		for (int i = 0; i < d.n; i++)
+			add(d.rects[i]);
+		full = full || d.full;
+	}
+
+	/* repaint everything, rects are still collected */
+	void all() {
+		full = true;
+	}
+
+	void clear() {
+		n = 0;
+		full = false;
+	}
+
+	int size() const {
+		return n;
+	}
+
+	const rect_t& operator[](int i) const {
+		return rects[i];
+	}
+
+	damage_t() : n(0), full(false) {}
+};
+
+/***************************************************************
+ * SIMULATION
+ ***************************************************************/
+
+/*
+ * where things were before the last tick, so a front end that draws
+ * in between ticks can interpolate. enemy projectiles all move at
+ * ENEMY_PROJ_SPEED so they don't need saving.
+ */
+struct prev_state_t {
+	pt_t anchor, player, proj;
+	pt_t mothership, destroyer, meteor;
+
+	/* box around the live aliens, for damage tracking */
+	rect_t grid;
+
+	/* things that weren't around last tick just get drawn where they are */
+	bool proj_on, mothership_on, destroyer_on, meteor_on;
+};
+
+inline pt_t lerp_pt(pt_t a, pt_t b, float t) {
+	return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t };
+}
+
+/* feature observation for bots, see sim_state_t::observe */
+#define OBS_SCALARS 11
+#define OBS_GRID_COLS 8
+#define OBS_GRID_ROWS 3
+#define OBS_SPECIALS 3
+#define OBS_SHOTS 8
+#define OBS_FEATURES (OBS_SCALARS + OBS_GRID_COLS * OBS_GRID_ROWS + OBS_SPECIALS * 3 + OBS_SHOTS * 2)
+
+/* what a rect from sim_state_t::each_rect is, pixel observations draw each on its own */
+enum obs_layer_t {
+	kObsPlayer,
+	kObsInvaders,
+	kObsShots,
+	_kObsEnd
+};
+
+/*
+ * what a sim has room for. it's all fixed arrays inside the sim, so this
+ * is also how big a sim is and what copying one costs. the game (and its
+ * snapshots) goes by capacity.h, bots that clone states by the thousand
+ * use bot_limits_t, which fits every level and not much more.
+ */
+template <int Cols, int Rows, int Shots>
+struct sim_limits_t {
+	enum {
+		cols = Cols,
+		rows = Rows,
+		aliens = Cols * Rows,
+		events = 2 * Cols * Rows,
+		shots = Shots
+	};
+};
+
+typedef sim_limits_t<GRID_MAX_COLS, GRID_MAX_ROWS, PROJ_POOL_SIZE> game_limits_t;
+typedef sim_limits_t<16, 4, 256> bot_limits_t;
+
+static_assert(game_limits_t::events == SCHED_MAX_EVENTS, "scheduler can't hold every grid event");
+
+/*
+ * windowless game state and rules. tick() advances the world by one
+ * fixed step and reports whether anything visible changed, it's up to
+ * whoever owns the sim to decide when to call it and what to do with
+ * the result (redraw, keep stepping, etc).
+ *
+ * the state is a plain value: fixed size, no pointers, nothing on the
+ * heap, so a game is cloned by assigning it and two copies go on
+ * independently. that's what lookahead bots need, see step(). how big
+ * the grid, schedule and shot pool are is up to L (sim_limits_t):
+ * sim_state_t is the game, bot_state_t is a few KB. front ends use
+ * sim_t, which adds hooks on top.
+ */
+template <class L>
+class basic_sim_state_t {
+protected:
+	typedef enemy_grid_t<L::cols, L::rows> grid_t;
+
+	int speed,
+		columns,
+		lives,
+		points,
+		state,
+		level,
+		movement_dir,
+		enemy_count,
+		highscore,
+		player_delta;
+
+	/* playfield size */
+	float surface_w, surface_h;
+
+	/* base vector of the enemy grid */
+	pt_t enemy_anchor;
+
+	/* player instance */
+	player_t player;
+
+	/* every random decision in the game comes from here */
+	rng_t rng;
+
+	/* random events and the tick counter they're scheduled against */
+	scheduler_t<L::events> events;
+	uint64_t now;
+
+	/* what seed() was given, a recording starts from it */
+	uint64_t seeded;
+
+	/* state before the last tick */
+	prev_state_t prev;
+
+	void save_prev() {
+		prev.anchor = enemy_anchor;
+		prev.player = player.pt;
+		prev.proj = { player.proj.x, player.proj.y };
+		prev.mothership = enemy_mothership.pos;
+		prev.destroyer = enemy_destroyer.pos;
+		prev.meteor = enemy_meteor.pos;
+		prev.grid = grid_box();
+
+		prev.proj_on = player.proj.y > 0;
+		prev.mothership_on = enemy_mothership.active;
+		prev.destroyer_on = enemy_destroyer.active;
+		prev.meteor_on = enemy_meteor.active;
+	}
+
+	/* enemy grid */
+	grid_t grid;
+
+	/* screen areas touched since the last draw, if track_damage is on */
+	damage_t damage;
+	bool track_damage;
+
+	/* live aliens' bounding box on screen */
+	rect_t grid_box() {
+		rect_t r = grid.extent();
+		r.pt.x += enemy_anchor.x;
+		r.pt.y += enemy_anchor.y;
+		return r;
+	}
+
+	/*
+	 * queue up everything this tick moved, spawned or killed. each thing
+	 * gets the box from where it was to where it is, anything drawn in
+	 * between (interpolated) lands inside it. enemy projectiles are done
+	 * in tick() since the pool forgets the dead ones.
+	 */
+	void note_damage() {
+		damage.add(rect_union({ prev.player, PLAYER_WIDTH, PLAYER_HEIGHT },
+							  { player.pt, PLAYER_WIDTH, PLAYER_HEIGHT }));
+
+		damage.add(rect_span(prev.proj_on, { prev.proj, PROJ_WIDTH, PROJ_HEIGHT },
+							 player.proj.y > 0, { { player.proj.x, player.proj.y }, PROJ_WIDTH, PROJ_HEIGHT }));
+
+		rect_t g = grid_box();
+		damage.add(rect_span(!rect_empty(prev.grid), prev.grid, !rect_empty(g), g));
+
+		note_damage(enemy_mothership, prev.mothership, prev.mothership_on);
+		note_damage(enemy_destroyer, prev.destroyer, prev.destroyer_on);
+		note_damage(enemy_meteor, prev.meteor, prev.meteor_on);
+	}
+
+	void note_damage(e_independent_t& e, pt_t p, bool p_on) {
+		damage.add(rect_span(p_on, { p, e.w, e.h }, e.active, { e.pos, e.w, e.h }));
+	}
+
+	/* we don't keep track of who fired the projectile since
+
+	 */
+	projectile_pool_t<L::shots> enemy_projectiles;
+
+	/*
+	 * special enemies (can only have one on screen at a
+	 * given time so having more here would make no sense.
+	 */
+	e_mothership_t enemy_mothership;
+	e_destroyer_t enemy_destroyer;
+	e_meteor_t enemy_meteor;
+
+	/* calc midx of player sprite */
+	inline float player_midx() {
+		return (player.pt.x) + (PLAYER_WIDTH / 2.0f);
+	}
+
+	/* a round ended this tick, sim_t passes it on */
+	bool round_over;
+
+	void start_mothership() {
+		state = STATE_PLAYING | STATE_MOTHERSHIP;
+
+		enemy_count++;
+		enemy_mothership.pos.x = 0;
+		enemy_mothership.pos.y = enemy_mothership.h;
+		enemy_mothership.act();
+
+		/* fire odds just went up, this tick's rolls haven't happened yet */
+		schedule_grid(now);
+	}
+
+	/*
+	 * gets called when enemy counter hits 0. either enter
+	 * mothership stage or genuinely win (after mothership)
+	 */
+	void win() {
+		round_over = true;
+		damage.all();
+
+		if (state & STATE_MOTHERSHIP) {
+			state = STATE_WON;
+		}
+		else {
+			start_mothership();
+		}
+	}
+
+	void lose() {
+		round_over = true;
+		damage.all();
+		state = STATE_LOST;
+	}
+
+	inline bool advance_if_active(e_independent_t& e) {
+		if (!e.active)
+			return false;
+
+		return e.advance(speed, surface_w, surface_h);
+	}
+
+	void on_enemy_hit(int sc) {
+		points += sc;
+		enemy_count--;
+
+		if (points > highscore) {
+			highscore = points;
+		}
+	}
+
+	void on_player_hit() {
+		lives--;
+
+		if (!lives) lose();
+	}
+
+	/*
+	 * serialize/unserialize, see snapshot.h for the layout
+	 *
+	 * the game data followed by the special enemies and the grid, each
+	 * enemy identified by its texture id.
+	 */
+
+	/* the special enemy a snapshot record is for, NULL if none */
+	e_independent_t* independent_of(uint32_t tex) {
+		switch (tex) {
+			case kTexDestroyer: return &enemy_destroyer;
+			case kTexMeteor: return &enemy_meteor;
+			case kTexMothership: return &enemy_mothership;
+			default: return NULL;
+		}
+	}
+
+public:
+	/*
+	 * load a snapshot from p, which can be a read-only mapping of the
+	 * file. everything is checked before anything is touched, if it
+	 * returns false the game is as it was. replaces the grid, and the
+	 * tick counter, rng and schedule, the game goes on exactly as the
+	 * one that was saved would have.
+	 */
+	bool unmarshal(const uint8_t* p, size_t n) {
+		snapshot_view_t v;
+
+		if (!v.check(p, n))
+			return false;
+
+		/* has to fit this sim, which may be smaller than the game */
+		if (v.header->n_anchored > (uint32_t)L::aliens || v.header->n_events > (uint32_t)L::events ||
+			v.header->n_projectiles > (uint32_t)L::shots)
+			return false;
+
+		const snap_game_t& g = *v.game;
+
+		if (g.level < 0 || g.level > MAX_LEVEL)
+			return false;
+
+		for (uint32_t i = 0; i < v.header->n_independent; i++) {
+			if (!independent_of(v.independent[i].base.tex))
+				return false;
+		}
+
+		/*
+		 * one alien per cell, and what each one can do (a bit per
+		 * event_kind_t) so the events can be checked against it.
+		 * record i ends up in grid slot i.
+		 */
+		uint8_t taken[L::aliens] = {};
+		uint8_t can[L::aliens];
+
+		for (uint32_t i = 0; i < v.header->n_anchored; i++) {
+			const snap_anchored_t& r = v.anchored[i];
+
+			if (!grid_t::fits(r.col, r.row) || taken[r.row * L::cols + r.col])
+				return false;
+			taken[r.row * L::cols + r.col] = 1;
+
+			e_anchored_t* e = e_anchored_t::make(static_cast<texture_t>(r.base.tex));
+			if (!e)
+				return false;
+
+			can[i] = (dynamic_cast<e_fireable_t*>(e) ? 1 << kEvGridFire : 0) |
+					 (dynamic_cast<e_cloakable_t*>(e) ? 1 << kEvGridCloak : 0);
+			delete e;
+		}
+
+		/* events are for grid slots that can do them and have to come in heap order */
+		for (uint32_t i = 0; i < v.header->n_events; i++) {
+			const snap_event_t& e = v.events[i];
+
+			if (e.slot < 0 || (uint32_t)e.slot >= v.header->n_anchored ||
+				(e.kind != kEvGridFire && e.kind != kEvGridCloak) || !(can[e.slot] & (1 << e.kind)))
+				return false;
+
+			if (i && v.events[(i-1) / 2].due.get() > e.due.get())
+				return false;
+		}
+
+		columns = g.columns;
+		speed = g.speed;
+		lives = g.lives;
+		points = g.points;
+		movement_dir = g.movement_dir;
+		enemy_count = g.enemy_count;
+		state = g.state;
+		level = g.level;
+		enemy_anchor.x = g.anchor_x;
+		enemy_anchor.y = g.anchor_y;
+
+		/* player */
+		player.pt.x = g.player_x;
+		player.pt.y = g.player_y;
+
+		for (uint32_t i = 0; i < v.header->n_independent; i++)
+			independent_of(v.independent[i].base.tex)->unmarshal(v.independent[i]);
+
+		grid.clear();
+
+		for (uint32_t i = 0; i < v.header->n_anchored; i++) {
+			const snap_anchored_t& r = v.anchored[i];
+
+			e_anchored_t* e = e_anchored_t::make(static_cast<texture_t>(r.base.tex));
+			e->unmarshal(r);
+			grid.push(*e);
+			delete e;
+		}
+
+		const snap_run_t& r = *v.run;
+
+		now = r.now.get();
+		rng.unmarshal(r.rng);
+		events.unmarshal(r, v.events, v.header->n_events);
+		/* only ever goes up, an old save mustn't lower it */
+		highscore = std::max(highscore, (int)r.highscore);
+		player_delta = r.player_delta;
+		player.proj.x = r.proj_x;
+		player.proj.y = r.proj_y;
+
+		enemy_projectiles.unmarshal(v.projectiles, v.header->n_projectiles);
+
+		/* nothing to interpolate from */
+		save_prev();
+		damage.all();
+		return true;
+	}
+
+	/* the whole game as a snapshot, in one buffer */
+	void marshal(std::vector<uint8_t>& buf) {
+		sim_capture_t c;
+		capture(c);
+		c.marshal(buf);
+	}
+
+	/*
+	 * what a bot sees, OBS_FEATURES floats into out. positions are
+	 * divided by the surface size so everything is roughly 0..1:
+	 *
+	 *   player x, player delta (-1, 0, 1), shot on, shot x, shot y,
+	 *   anchor x, anchor y, grid direction, lives / 3, mothership stage,
+	 *   level / MAX_LEVEL
+	 *   1 per live alien, OBS_GRID_ROWS rows of OBS_GRID_COLS
+	 *   meteor, mothership, destroyer: active, x, y
+	 *   the OBS_SHOTS enemy shots closest to the bottom: x, y (0 if fewer)
+	 */
+	void observe(float* out) {
+		float sx = 1.0f / surface_w, sy = 1.0f / surface_h;
+		bool shot = player.proj.y > 0;
+
+		*out++ = player.pt.x * sx;
+		*out++ = (float)player_delta / PLAYER_SPEED;
+		*out++ = shot;
+		*out++ = shot ? player.proj.x * sx : 0;
+		*out++ = shot ? player.proj.y * sy : 0;
+		*out++ = enemy_anchor.x * sx;
+		*out++ = enemy_anchor.y * sy;
+		*out++ = movement_dir;
+		*out++ = lives / 3.0f;
+		*out++ = (state & STATE_MOTHERSHIP) != 0;
+		*out++ = (float)level / MAX_LEVEL;
+
+		std::fill(out, out + OBS_GRID_COLS * OBS_GRID_ROWS, 0.0f);
+		for (size_t i = 0; i < grid.size(); i++) {
+			if (grid.active[i] && grid.col[i] < OBS_GRID_COLS && grid.row[i] < OBS_GRID_ROWS)
+				out[grid.row[i] * OBS_GRID_COLS + grid.col[i]] = 1;
+		}
+		out += OBS_GRID_COLS * OBS_GRID_ROWS;
+
+		e_independent_t* specials[OBS_SPECIALS] = { &enemy_meteor, &enemy_mothership, &enemy_destroyer };
+		for (e_independent_t* e : specials) {
+			*out++ = e->active;
+			*out++ = e->active ? e->pos.x * sx : 0;
+			*out++ = e->active ? e->pos.y * sy : 0;
+		}
+
+		/* keep the lowest shots, insertion into a short sorted list */
+		size_t low[OBS_SHOTS], n = 0;
+		for (size_t i = 0; i < enemy_projectiles.size(); i++) {
+			float y = enemy_projectiles.y(i);
+			if (n == OBS_SHOTS && y <= enemy_projectiles.y(low[n-1]))
+				continue;
+
+			size_t k = n < OBS_SHOTS ? n++ : n - 1;
+			for (; k > 0 && enemy_projectiles.y(low[k-1]) < y; k--)
+				low[k] = low[k-1];
+			low[k] = i;
+		}
+
+		for (size_t k = 0; k < OBS_SHOTS; k++) {
+			*out++ = k < n ? enemy_projectiles.x(low[k]) * sx : 0;
+			*out++ = k < n ? enemy_projectiles.y(low[k]) * sy : 0;
+		}
+	}
+
+	/*
+	 * f(layer, rect) for everything paint() would draw, where it is now
+	 * (no interpolation, no HUD). for drawing the game without being a
+	 * scene_t, see obs.h.
+	 */
+	template <typename F>
+	void each_rect(F f) {
+		if (!(state & STATE_PLAYING))
+			return;
+
+		f(kObsPlayer, rect_t{ player.pt, PLAYER_WIDTH, PLAYER_HEIGHT });
+
+		if (player.proj.y > 0)
+			f(kObsShots, rect_t{ { player.proj.x, player.proj.y }, PROJ_WIDTH, PROJ_HEIGHT });
+
+		if (state & STATE_MOTHERSHIP) {
+			if (enemy_mothership.is_visible())
+				f(kObsInvaders, rect_t{ enemy_mothership.pos, enemy_mothership.w, enemy_mothership.h });
+		}
+		else {
+			if (enemy_destroyer.is_visible())
+				f(kObsInvaders, rect_t{ enemy_destroyer.pos, enemy_destroyer.w, enemy_destroyer.h });
+			if (enemy_meteor.is_visible())
+				f(kObsInvaders, rect_t{ enemy_meteor.pos, enemy_meteor.w, enemy_meteor.h });
+
+			for (size_t i = 0; i < grid.size(); i++) {
+				if (grid.visible[i])
+					f(kObsInvaders, rect_t{ anchored_vec(i), grid.w, grid.h });
+			}
+		}
+
+		for (size_t i = 0; i < enemy_projectiles.size(); i++)
+			f(kObsShots, rect_t{ { enemy_projectiles.x(i), enemy_projectiles.y(i) }, PROJ_WIDTH, PROJ_HEIGHT });
+	}
+
+	/* copy out what a snapshot needs, cheap enough to do between ticks */
+	void capture(sim_capture_t& c) {
+		snap_game_t& g = c.game;
+		g.columns = columns;
+		g.speed = speed;
+		g.lives = lives;
+		g.points = points;
+		g.movement_dir = movement_dir;
+		g.enemy_count = enemy_count;
+		g.state = state;
+		g.level = level;
+		g.anchor_x = enemy_anchor.x;
+		g.anchor_y = enemy_anchor.y;
+
+		/* player */
+		g.player_x = player.pt.x;
+		g.player_y = player.pt.y;
+
+		snap_run_t& r = c.run;
+		r.now.set(now);
+		rng.marshal(r.rng);
+		events.marshal(r, c.events);
+		r.highscore = highscore;
+		r.player_delta = player_delta;
+		r.proj_x = player.proj.x;
+		r.proj_y = player.proj.y;
+
+		enemy_projectiles.marshal(c.projectiles);
+
+		enemy_meteor.marshal(c.independent[0]);
+		enemy_mothership.marshal(c.independent[1]);
+		enemy_destroyer.marshal(c.independent[2]);
+
+		size_t n = grid.size();
+		c.col.assign(grid.col, grid.col + n);
+		c.row.assign(grid.row, grid.row + n);
+		c.points.assign(grid.points, grid.points + n);
+		c.active.assign(grid.active, grid.active + n);
+		c.visible.assign(grid.visible, grid.visible + n);
+		c.type.assign(grid.type, grid.type + n);
+		c.w = grid.w;
+		c.h = grid.h;
+	}
+
+	/*
+	 * hash of everything the next tick depends on (see state_hash_t),
+	 * for checking a replay ended up where the recording did. what's
+	 * only kept for drawing (prev, damage) is left out.
+	 */
+	uint64_t digest() {
+		state_hash_t h;
+
+		int scalars[] = { speed, columns, lives, points, state, level,
+						  movement_dir, enemy_count, highscore, player_delta };
+		h.add(scalars);
+		h.add(surface_w);
+		h.add(surface_h);
+		h.add(enemy_anchor);
+		h.add(player.pt);
+		h.add(player.proj.x);
+		h.add(player.proj.y);
+		h.add(now);
+
+		rng.hash(h);
+		events.hash(h);
+		grid.hash(h);
+		enemy_projectiles.hash(h);
+
+		snap_independent_t r[3];
+		enemy_meteor.marshal(r[0]);
+		enemy_mothership.marshal(r[1]);
+		enemy_destroyer.marshal(r[2]);
+		h.add(r);
+
+		return h.value();
+	}
+
+protected:
+
+	/*
+	 * during the mothership stage, mothership should fire with
+	 * a high probability.
+	 */
+	inline uint32_t fire_odds() {
+		return state & STATE_MOTHERSHIP ? HIGH_ODDS : LOW_ODDS;
+	}
+
+	/* shoot from the bottom middle of r */
+	void enemy_fire(rect_t r) {
+		enemy_projectiles.spawn(r.pt.x + (r.w / 2), r.pt.y + r.h);
+	}
+
+	void process_enemy_fire(e_fireable_t& ee, e_independent_t& e, int c) {
+		if (e.active && events.roll(c, now, fire_odds(), rng)) {
+			enemy_fire({e.pos, e.w, e.h});
+		}
+	}
+
+	void process_enemy_cloak(e_cloakable_t& ee, enemy_t& e, int c) {
+		if (e.active && events.roll(c, now, MEDIUM_ODDS, rng)) {
+			e.visible = !e.visible;
+		}
+	}
+
+	/*
+	 * (re)build the grid's event schedule, every live alien that can
+	 * fire or cloak gets its first event. has to be redone whenever
+	 * fire_odds() changes, i.e. on entering the mothership stage (which
+	 * can happen with aliens left when enemy_count runs out early).
+	 * `from` is the first tick that rolls.
+	 */
+	void schedule_grid(uint64_t from) {
+		events.clear();
+
+		for (int k = 0; k < grid.n_fireable; k++) {
+			int i = grid.fireable[k];
+			if (grid.active[i])
+				events.push(from, i, kEvGridFire, fire_odds(), rng);
+		}
+		for (int k = 0; k < grid.n_cloakable; k++) {
+			int i = grid.cloakable[k];
+			if (grid.active[i])
+				events.push(from, i, kEvGridCloak, MEDIUM_ODDS, rng);
+		}
+	}
+
+	/*
+	 * run the grid events that are due. dead aliens' events are simply
+	 * dropped, live ones get their next event scheduled.
+	 */
+	void process_grid_events() {
+		while (events.pending(now)) {
+			event_t e = events.pop();
+
+			if (!grid.active[e.slot])
+				continue;
+
+			if (e.kind == kEvGridFire) {
+				enemy_fire({ anchored_vec(e.slot), grid.w, grid.h });
+				events.push(now + 1, e.slot, e.kind, fire_odds(), rng);
+			}
+			else {
+				grid.visible[e.slot] = !grid.visible[e.slot];
+				events.push(now + 1, e.slot, e.kind, MEDIUM_ODDS, rng);
+			}
+		}
+	}
+
+	/* calculate rightmost active  x for enemy grid */
+	float calc_rightmost() {
+		rect_t r = grid.extent();
+		return r.pt.x + r.w + enemy_anchor.x;
+	}
+
+	/* leftmost active x */
+	float calc_leftmost() {
+		return grid.extent().pt.x + enemy_anchor.x;
+	}
+
+	/* bottommost active y */
+	float calc_bottommost() {
+		rect_t r = grid.extent();
+		return r.pt.y + r.h + enemy_anchor.y;
+	}
+
+	/* map anchored enemy to absoulute coords */
+	inline pt_t anchored_vec(size_t i) {
+		pt_t rela = grid.cell_pt(i);
+		return {
+			enemy_anchor.x + rela.x,
+			enemy_anchor.y + rela.y
+		};
+	}
+
+	/* function template to create grid enemies */
+	template <typename T>
+	void create_grid_alien(int c, int r) {
+		T e;
+		e.grid_col = c;
+		e.grid_row = r;
+
+		/* add enemy to the grid, it copies what it needs */
+		if (grid.push(e))
+			enemy_count++;
+	}
+
+	/*
+	 * create a set of enemies for each colum.
+	 */
+	void create_enemies() {
+		/* populate columns */
+		for (int i = 0; i < columns; i++) {
+			/* populate LEVEL_ROWS rows with different enemy type for each row */
+			create_grid_alien<e_martian_t>(i, 0);
+			create_grid_alien<e_mercurian_t>(i, 1);
+			create_grid_alien<e_venusian_t>(i, 2);
+		}
+	}
+
+	void clear_enemies() {
+		grid.clear();
+	}
+
+	/* fully reset game state */
+	void reset() {
+		/* activate all enemies */
+		grid.act_all();
+
+		enemy_projectiles.clear();
+
+		/* at reset player is in the middle */
+		player.pt.x = (surface_w / 2.0f) - (PLAYER_WIDTH / 2.0f);
+		player.pt.y = surface_h - 50.0f;
+
+		/* reset enemy positions */
+		enemy_anchor.x = 0;
+		enemy_anchor.y = 30;
+
+		player.proj.y = -1;
+
+		/* reset score and lives */
+		points = 0;
+		lives = 3;
+
+		/* set initial enemy count */
+		enemy_count = static_cast<int>(grid.size());
+		state = STATE_PLAYING;
+
+		movement_dir = DIRECTION_LEFT_TO_RIGHT;
+
+		schedule_grid(now + 1);
+		save_prev();
+		damage.all();
+	}
+
+	/* load level data and populate enemies, false (and nothing changes) if it doesn't fit */
+	bool load_level(int l) {
+		if (!level_fits(l))
+			return false;
+
+		level = l;
+
+		clear_enemies();
+
+		/* load level info */
+		speed = gDifficultyLevels[level][0];
+		columns = gDifficultyLevels[level][1];
+
+		create_enemies();
+		return true;
+	}
+
+public:
+	/*
+	 * fixed rate tick function that is responsible for most
+	 * timed state updates within the game. returns true if
+	 * anything on screen changed.
+	 */
+	bool tick() {
+#define MARKS state_changed = true;
+		bool state_changed = false;
+
+		now++;
+		save_prev();
+
+		/* move player within screen bounds */
+		if ((player.pt.x+player_delta) >= 0 && (player.pt.x+player_delta) < (surface_w-PLAYER_WIDTH))
+			player.pt.x += player_delta;
+
+		/*
+		 * this is done in a more convoluted way than the case
+		 * with a single enemy since we need to calculate sizes
+		 * for the enemy grid.
+		 */
+		if (movement_dir == DIRECTION_LEFT_TO_RIGHT) {
+			float rightmost = calc_rightmost();
+
+			if (surface_w < (rightmost + speed))
+				movement_dir = DIRECTION_RIGHT_TO_LEFT;
+			else {
+				enemy_anchor.x += speed;
+				MARKS
+			}
+		}
+		else {
+			if (calc_leftmost()	< (0+speed))
+				movement_dir = DIRECTION_LEFT_TO_RIGHT;
+			else {
+				enemy_anchor.x -= speed;
+				MARKS
+			}
+		}
+
+		/* avoid over/underdraw */
+		if (!state_changed) {
+			enemy_anchor.y += 20;
+		}
+
+		/* advance unique enemies */
+		state_changed = advance_if_active(enemy_mothership) || state_changed;
+		state_changed = advance_if_active(enemy_destroyer) || state_changed;
+
+		/*
+		 * if the meteor reached player's line, lose a life
+		 */
+		state_changed = advance_if_active(enemy_meteor) || state_changed;
+
+		/* advance player's single projectile if needed */
+		if (player.proj.y > 0) {
+			/* hit-test, only looks at the cells under the projectile */
+			int i = grid.find_hit(player.proj, enemy_anchor);
+
+			if (i >= 0) {
+				/* collision, deal with the enemy */
+				on_enemy_hit(grid.die(i));
+
+				/* get rid of the projectile */
+				player.proj.deact();
+			}
+
+			player.proj.y -= PLAYER_PROJ_SPEED;
+			MARKS
+		}
+
+		if (enemy_count == 0) {
+			win();
+			MARKS
+		}
+
+		/*
+		 * if invaders reached player, it's an instant game loss
+		 */
+		else if (calc_bottommost() >= player.pt.y) {
+			lose();
+			MARKS
+		}
+
+		/* introduce and handle enemies that appear by chance */
+		if (state & STATE_PLAYING) {
+			/* only introduce them during the main fight phase */
+			if ((state & STATE_MOTHERSHIP) == 0) {
+				/*
+				 * meteor: start at a random Y. if it reaches
+				 * bottom of the screen, lose a life.
+				 */
+				if (!enemy_meteor.active) {
+					if (events.roll(kChanceMeteor, now, MEDIUM_ODDS, rng)) {
+						enemy_count++;
+						enemy_meteor.pos.y = 0;
+						enemy_meteor.pos.x = (float)rng.below((uint32_t)(surface_w - enemy_meteor.w));
+						enemy_meteor.act();
+					}
+				}
+				else if (enemy_meteor.pos.y+enemy_meteor.h > player.pt.y) {
+					enemy_count--;
+					enemy_meteor.deact();
+					on_player_hit();
+				}
+				else {
+					int sc = enemy_meteor.collide(player.proj);
+					if (sc) on_enemy_hit(sc);
+				}
+
+				/*
+				 * destroyer
+				 */
+				if (!enemy_destroyer.active) {
+					if (events.roll(kChanceDestroyer, now, MEDIUM_ODDS, rng)) {
+						enemy_count++;
+						enemy_destroyer.pos.y = 10;
+						enemy_destroyer.pos.x = 0;
+						enemy_destroyer.act();
+					}
+				}
+				else if (enemy_destroyer.pos.x > surface_w) {
+					enemy_count--;
+					enemy_destroyer.deact();
+				}
+				else {
+					int sc = enemy_destroyer.collide(player.proj);
+					if (sc) on_enemy_hit(sc);
+				}
+			}
+			else {
+				/* mothership */
+				int sc = enemy_mothership.collide(player.proj);
+				if (sc) on_enemy_hit(sc);
+			}
+
+			/* cloaked/fireable enemies */
+			process_grid_events();
+
+			process_enemy_fire(enemy_mothership, enemy_mothership, kChanceMothershipFire);
+			process_enemy_cloak(enemy_destroyer, enemy_destroyer, kChanceDestroyerCloak);
+
+			/* each one covers where it is and where it's about to be */
+			if (track_damage) {
+				for (size_t i = 0; i < enemy_projectiles.size(); i++)
+					damage.add({ { enemy_projectiles.x(i), enemy_projectiles.y(i) }, PROJ_WIDTH, PROJ_HEIGHT + ENEMY_PROJ_SPEED });
+			}
+
+			/*
+			 * advance enemy projectiles, dropping the ones that hit
+			 * the player or went off screen
+			 */
+			int hits = enemy_projectiles.advance(ENEMY_PROJ_SPEED, surface_h, {player.pt, PLAYER_WIDTH, PLAYER_HEIGHT});
+			while (hits--)
+				on_player_hit();
+
+			/* handle fireables and cloakables */
+			MARKS
+		}
+
+		if (track_damage)
+			note_damage();
+
+		return state_changed;
+#undef MARKS
+	}
+
+	/*
+	 * pressing enter: start the next round (or the next level) if the
+	 * current one is over. returns true if a new round was started.
+	 */
+	bool reset_if_possible() {
+		if (state & STATE_PLAYING)
+			return false;
+		else if (state & STATE_WON) {
+			/* init() made sure every level fits, so this can't fail */
+			if (level < MAX_LEVEL-1) {
+				load_level(level+1);
+			}
+		}
+		reset();
+		return true;
+	}
+
+	void player_fire() {
+		player.proj.y = player.pt.y - PLAYER_HEIGHT;
+		player.proj.x = player_midx() - 1;
+
+		/* new shot, don't draw it sliding over from the old one */
+		prev.proj_on = false;
+	}
+
+	/*
+	 * like player_fire() but doesn't restart a projectile in flight,
+	 * returns true if it fired
+	 */
+	bool player_fire_if_ready() {
+		if (player.proj.y > 0)
+			return false;
+
+		player_fire();
+		return true;
+	}
+
+	/* horizontal player velocity in px/tick, 0 when no key is held */
+	void set_player_delta(int d) {
+		player_delta = d;
+	}
+
+	int get_state() {
+		return state;
+	}
+
+	int get_points() {
+		return points;
+	}
+
+	int get_lives() {
+		return lives;
+	}
+
+	int get_level() {
+		return level;
+	}
+
+	/* ticks run so far */
+	uint64_t get_tick() {
+		return now;
+	}
+
+	uint64_t get_seed() {
+		return seeded;
+	}
+
+	/* the highscore comes from outside (a file), a replay has to start from the same one */
+	void set_highscore(int h) {
+		highscore = h;
+	}
+
+	/* keep track of what changed on screen each tick (see damage_t) */
+	void set_damage_tracking(bool on) {
+		track_damage = on;
+		damage.clear();
+		damage.all();
+	}
+
+	/* level l's grid fits in this sim */
+	static bool level_fits(int l) {
+		return gDifficultyLevels[l][1] <= L::cols && LEVEL_ROWS <= L::rows;
+	}
+
+	/* every level does, i.e. this sim can play the game */
+	static bool levels_fit() {
+		for (size_t l = 0; l < sizeof(gDifficultyLevels) / sizeof(gDifficultyLevels[0]); l++) {
+			if (!level_fits(static_cast<int>(l)))
+				return false;
+		}
+		return true;
+	}
+
+	/* same seed + same input = same game */
+	void seed(uint64_t s) {
+		seeded = s;
+		rng.seed(s);
+	}
+
+	/*
+	 * set up the playfield and the first level. the sim starts out
+	 * waiting for the player (STATE_RESUME). false if some level doesn't
+	 * fit in L, such a sim can't play the game.
+	 */
+	bool init(float w, float h) {
+		if (!levels_fit())
+			return false;
+
+		now = 0;
+
+		/* surface size */
+		surface_h = h;
+		surface_w = w;
+		player_delta = 0;
+		highscore = 0;
+		round_over = false;
+
+		load_level(0);
+		reset();
+
+		state = STATE_RESUME;
+		return true;
+	}
+
+	basic_sim_state_t() : seeded(0), track_damage(false), round_over(false) {
+
+	}
+};
+
+typedef basic_sim_state_t<game_limits_t> sim_state_t;
+typedef basic_sim_state_t<bot_limits_t> bot_state_t;
+
+/*
+ * the sim as front ends (the game, the headless driver, replays) use
+ * it: a sim_state_t that tells them when a round is over.
+ */
+class sim_t : public sim_state_t {
+protected:
+	/*
+	 * called when a round is over (won, lost or entering the mothership
+	 * stage), after the tick. front ends override this to persist the
+	 * highscore.
+	 */
+	virtual void on_round_over() {}
+
+public:
+	bool tick() {
+		bool changed = sim_state_t::tick();
+
+		if (round_over) {
+			round_over = false;
+			on_round_over();
+		}
+
+		return changed;
+	}
+
+	virtual ~sim_t() {}
+};
+
+/***************************************************************
+ * STEPPING FOR BOTS
+ ***************************************************************/
+
+/* what a bot does for a step, or'd together */
+enum sim_action_t {
+	kActLeft = 0x1,
+	kActRight = 0x2,
+	kActFire = 0x4,
+	_kActEnd = 0x8
+};
+
+/*
+ * one step of a game in progress: hold left/right (both or neither
+ * stands still), fire if asked (like the fire key, that restarts a shot
+ * in flight) and tick. returns the points the tick scored. a round
+ * that's over doesn't step, the caller decides what happens next
+ * (reset_if_possible() is the enter key). needs nothing but the state,
+ * so bots can step as many clones as they like, on any thread.
+ */
+template <class S>
+inline int step(S& s, int action) {
+	if (!(s.get_state() & STATE_PLAYING))
+		return 0;
+
+	int dx = 0;
+	if (action & kActLeft) dx -= PLAYER_SPEED;
+	if (action & kActRight) dx += PLAYER_SPEED;
+	s.set_player_delta(dx);
+
+	if (action & kActFire)
+		s.player_fire();
+
+	int before = s.get_points();
+	s.tick();
+	return s.get_points() - before;
+}
+
+#endif /* INVADERS_SIM_H */
@@ -0,0 +1,251 @@
+/*
+ * space invaders game - snapshot format
+ *
+ * a saved game is one contiguous block, built in memory and written out
+ * in one go (see writer.h):
+ *
+ *   snap_header_t
+ *   snap_game_t                          (score, level state, player)
+ *   snap_run_t                           (tick, rng, chance table, shot)
+ *   snap_independent_t * n_independent   (mothership, destroyer, meteor)
+ *   snap_anchored_t * n_anchored         (the alien grid)
+ *   snap_event_t * n_events              (the grid's scheduled events)
+ *   snap_projectile_t * n_projectiles    (enemy shots in flight)
+ *
+ * that's all of the sim's state, a loaded snapshot carries on exactly
+ * like the game it was taken from would have (replay keyframes rely on
+ * it, see replay.h).
+ *
+ * every record is fixed size and made of 4 byte fields, so a snapshot
+ * can be used right where it sits (e.g. in a mapping of the file) once
+ * snapshot_view_t has checked it. numbers are in host byte order.
+ */
+
+#ifndef INVADERS_SNAPSHOT_H
+#define INVADERS_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "capacity.h"
+
+#define SNAPSHOT_MAGIC "IVSV"
+#define SNAPSHOT_VERSION 2
+
+/* what the game can hold (capacity.h), anything past this is a broken file */
+#define SNAPSHOT_MAX_INDEPENDENT 8
+#define SNAPSHOT_MAX_ANCHORED GRID_MAX_ALIENS
+#define SNAPSHOT_MAX_EVENTS SCHED_MAX_EVENTS
+#define SNAPSHOT_MAX_PROJECTILES PROJ_POOL_SIZE
+
+/* entries in the scheduler's chance table (sim.h's _kChanceEnd) */
+#define SNAPSHOT_CHANCES 4
+
+/***************************************************************
+ * RECORDS
+ ***************************************************************/
+
+struct snap_header_t {
+	char magic[4];
+	uint32_t version;
+
+	/* whole snapshot, header included */
+	uint32_t size;
+
+	/* crc32 of everything after the header */
+	uint32_t crc;
+
+	uint32_t n_independent, n_anchored;
+	uint32_t n_events, n_projectiles;
+};
+
+/* 64 bit numbers are kept as two halves so records stay 4 byte aligned */
+struct snap_u64_t {
+	uint32_t lo, hi;
+
+	uint64_t get() const {
+		return lo | (static_cast<uint64_t>(hi) << 32);
+	}
+
+	void set(uint64_t v) {
+		lo = static_cast<uint32_t>(v);
+		hi = static_cast<uint32_t>(v >> 32);
+	}
+};
+
+struct snap_game_t {
+	int32_t columns, speed, lives, points;
+	int32_t movement_dir, enemy_count, state, level;
+	float anchor_x, anchor_y;
+	float player_x, player_y;
+};
+
+/* what decides how the game goes on from here */
+struct snap_run_t {
+	snap_u64_t now;
+	uint32_t rng[4];
+
+	/* scheduler_t's chance table */
+	snap_u64_t due[SNAPSHOT_CHANCES];
+	uint32_t due_odds[SNAPSHOT_CHANCES];
+
+	int32_t highscore, player_delta;
+
+	/* the player's shot */
+	float proj_x, proj_y;
+};
+
+/* fields every enemy has */
+struct snap_enemy_t {
+	/* texture_t, says what kind of enemy it is */
+	uint32_t tex;
+	int32_t points;
+	uint8_t visible, active, pad[2];
+	float w, h;
+};
+
+struct snap_independent_t {
+	snap_enemy_t base;
+	int32_t axis, dir, lives, max_lives;
+	float speed_factor;
+	float x, y;
+};
+
+struct snap_anchored_t {
+	snap_enemy_t base;
+	int32_t col, row;
+};
+
+/* in the scheduler's heap order, slot is the grid alien it's for */
+struct snap_event_t {
+	snap_u64_t due;
+	int32_t slot, kind;
+};
+
+struct snap_projectile_t {
+	float x, y;
+};
+
+/***************************************************************
+ * CHECKSUM
+ ***************************************************************/
+
+/* crc32 (the zlib one), a byte at a time off a table */
+inline uint32_t snapshot_crc32(const uint8_t* p, size_t n) {
+	struct table_t {
+		uint32_t t[256];
+
+		table_t() {
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[i] = c;
+			}
+		}
+	};
+	static const table_t table;
+
+	uint32_t c = 0xFFFFFFFFu;
+	for (size_t i = 0; i < n; i++)
+		c = table.t[(c ^ p[i]) & 0xff] ^ (c >> 8);
+	return c ^ 0xFFFFFFFFu;
+}
+
+/***************************************************************
+ * BUILDING AND READING
+ ***************************************************************/
+
+inline size_t snapshot_size(uint32_t n_independent, uint32_t n_anchored,
+							 uint32_t n_events, uint32_t n_projectiles) {
+	return sizeof(snap_header_t) + sizeof(snap_game_t) + sizeof(snap_run_t) +
+		   n_independent * sizeof(snap_independent_t) +
+		   n_anchored * sizeof(snap_anchored_t) +
+		   n_events * sizeof(snap_event_t) +
+		   n_projectiles * sizeof(snap_projectile_t);
+}
+
+/*
+ * typed pointers into a snapshot. for writing, layout() sizes a buffer
+ * and points into it, fill in the records and seal() it. for reading,
+ * check() validates someone else's bytes in place, nothing is copied.
+ */
+class snapshot_view_t {
+	uint8_t* base;
+
+	void point(const uint8_t* p) {
+		base = const_cast<uint8_t*>(p);
+		header = reinterpret_cast<snap_header_t*>(base);
+		game = reinterpret_cast<snap_game_t*>(header + 1);
+		run = reinterpret_cast<snap_run_t*>(game + 1);
+		independent = reinterpret_cast<snap_independent_t*>(run + 1);
+		anchored = reinterpret_cast<snap_anchored_t*>(independent + header->n_independent);
+		events = reinterpret_cast<snap_event_t*>(anchored + header->n_anchored);
+		projectiles = reinterpret_cast<snap_projectile_t*>(events + header->n_events);
+	}
+
+public:
+	snap_header_t* header;
+	snap_game_t* game;
+	snap_run_t* run;
+	snap_independent_t* independent;
+	snap_anchored_t* anchored;
+	snap_event_t* events;
+	snap_projectile_t* projectiles;
+
+	/* (re)size buf for a snapshot with this many records, zeroed */
+	void layout(std::vector<uint8_t>& buf, uint32_t n_independent, uint32_t n_anchored,
+				uint32_t n_events, uint32_t n_projectiles) {
+		buf.assign(snapshot_size(n_independent, n_anchored, n_events, n_projectiles), 0);
+
+		snap_header_t* h = reinterpret_cast<snap_header_t*>(buf.data());
+		memcpy(h->magic, SNAPSHOT_MAGIC, 4);
+		h->version = SNAPSHOT_VERSION;
+		h->size = static_cast<uint32_t>(buf.size());
+		h->n_independent = n_independent;
+		h->n_anchored = n_anchored;
+		h->n_events = n_events;
+		h->n_projectiles = n_projectiles;
+
+		point(buf.data());
+	}
+
+	/* records are all filled in, checksum them */
+	void seal() {
+		header->crc = snapshot_crc32(base + sizeof(snap_header_t), header->size - sizeof(snap_header_t));
+	}
+
+	/*
+	 * point at a snapshot in p if that's what it is: right magic and
+	 * version, sizes that add up to exactly n and a matching checksum.
+	 * p has to be 4 byte aligned. the records are only for reading
+	 * then, p may well be a read-only mapping.
+	 */
+	bool check(const uint8_t* p, size_t n) {
+		if (n < sizeof(snap_header_t))
+			return false;
+
+		const snap_header_t* h = reinterpret_cast<const snap_header_t*>(p);
+
+		if (memcmp(h->magic, SNAPSHOT_MAGIC, 4) || h->version != SNAPSHOT_VERSION || h->size != n)
+			return false;
+
+		if (h->n_independent > SNAPSHOT_MAX_INDEPENDENT || h->n_anchored > SNAPSHOT_MAX_ANCHORED ||
+			h->n_events > SNAPSHOT_MAX_EVENTS || h->n_projectiles > SNAPSHOT_MAX_PROJECTILES ||
+			snapshot_size(h->n_independent, h->n_anchored, h->n_events, h->n_projectiles) != n)
+			return false;
+
+		if (snapshot_crc32(p + sizeof(snap_header_t), n - sizeof(snap_header_t)) != h->crc)
+			return false;
+
+		point(p);
+		return true;
+	}
+
+	snapshot_view_t() : base(NULL), header(NULL), game(NULL), run(NULL), independent(NULL), anchored(NULL),
+						events(NULL), projectiles(NULL) {}
+};
+
+#endif /* INVADERS_SNAPSHOT_H */
@@ -0,0 +1,314 @@
+/*
+ * space invaders game - software renderer
+ *
+ * renderer_t that draws into an RGBA8 framebuffer in memory instead of
+ * through GL, so frames can be produced (and looked at, and timed) on
+ * machines with no GPU or display. it follows GL's rules closely enough
+ * that frames look the same: pixel centers at .5, nearest texture
+ * sampling, ONE/ONE_MINUS_SRC_ALPHA (premultiplied) blending and the
+ * same 9x15 font the GL renderer uses.
+ */
+
+#ifndef INVADERS_SOFTRENDER_H
+#define INVADERS_SOFTRENDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "render.h"
+#include "font9x15.h"
+
+/***************************************************************
+ * PIXELS
+ ***************************************************************/
+
+/* pixels are R, G, B, A bytes in memory, i.e. 0xAABBGGRR on little endian */
+inline uint32_t px_rgba(unsigned r, unsigned g, unsigned b, unsigned a) {
+	return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+inline uint32_t px_from_float(float r, float g, float b) {
+	return px_rgba(static_cast<unsigned>(r * 255 + 0.5f),
+				   static_cast<unsigned>(g * 255 + 0.5f),
+				   static_cast<unsigned>(b * 255 + 0.5f), 255);
+}
+
+/* x * y / 255, rounded, for 8 bit values */
+inline unsigned px_mul(unsigned x, unsigned y) {
+	unsigned t = x * y + 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+/*
+ * dst = src + dst * (1 - src_alpha) on every channel (alpha included),
+ * clamped, like glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA) with
+ * premultiplied src. 4 pixels at a time with SSE2, opaque and fully
+ * transparent groups take a shortcut since sprites are mostly one or
+ * the other.
+ */
+inline void blend_span(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i amask = _mm_set1_epi32(0xff000000);
+	const __m128i c255 = _mm_set1_epi16(255);
+	const __m128i c128 = _mm_set1_epi16(128);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i a = _mm_and_si128(s, amask);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, amask)) == 0xffff) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), s);
+			continue;
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xffff)
+			continue;
+
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+
+		/* widen dst to 16 bit lanes, 2 pixels per half */
+		__m128i dlo = _mm_unpacklo_epi8(d, zero), dhi = _mm_unpackhi_epi8(d, zero);
+
+		/* broadcast each pixel's 255 - alpha over its 4 lanes */
+		__m128i ilo = _mm_sub_epi16(c255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(_mm_unpacklo_epi8(s, zero), 0xff), 0xff));
+		__m128i ihi = _mm_sub_epi16(c255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(_mm_unpackhi_epi8(s, zero), 0xff), 0xff));
+
+		/* d * (255 - a) / 255, rounded, same as px_mul */
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(dlo, ilo), c128);
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(dhi, ihi), c128);
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+		__m128i out = _mm_adds_epu8(s, _mm_packus_epi16(lo, hi));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+	}
+#endif
+
+	for (; i < n; i++) {
+		uint32_t s = src[i], d = dst[i];
+		unsigned a = s >> 24;
+
+		if (a == 255) {
+			dst[i] = s;
+			continue;
+		}
+		if (s == 0)
+			continue;
+
+		uint32_t out = 0;
+		for (int sh = 0; sh < 32; sh += 8) {
+			unsigned c = ((s >> sh) & 0xff) + px_mul((d >> sh) & 0xff, 255 - a);
+			out |= std::min(c, 255u) << sh;
+		}
+		dst[i] = out;
+	}
+}
+
+/* multiply every channel of n pixels by tint (r, g, b, 255) */
+inline void tint_span(uint32_t* px, size_t n, uint32_t tint) {
+	unsigned tr = tint & 0xff, tg = (tint >> 8) & 0xff, tb = (tint >> 16) & 0xff;
+
+	for (size_t i = 0; i < n; i++) {
+		uint32_t p = px[i];
+		px[i] = px_rgba(px_mul(p & 0xff, tr), px_mul((p >> 8) & 0xff, tg),
+						px_mul((p >> 16) & 0xff, tb), p >> 24);
+	}
+}
+
+/***************************************************************
+ * SOFTWARE RENDERER
+ ***************************************************************/
+
+class soft_renderer_t : public renderer_t {
+	/* texture handle n is images[n-1], owned holds the pixels of decoded ones */
+	std::vector<image_view_t> images;
+	std::vector<std::vector<uint32_t> > owned;
+	unsigned cur_tex;
+
+	int fb_w, fb_h;
+	std::vector<uint32_t> fb;
+
+	/* pixels outside [clip_x0, clip_x1) x [clip_y0, clip_y1) are left alone */
+	int clip_x0, clip_y0, clip_x1, clip_y1;
+
+	/* scratch for textured quads: texel column per pixel and one row of texels */
+	std::vector<int> xmap;
+	std::vector<uint32_t> span;
+
+	/* first pixel whose center is at or after v */
+	static int to_px(float v) {
+		return static_cast<int>(ceilf(v - 0.5f));
+	}
+
+public:
+	virtual unsigned load_texture(const image_t& img) override {
+		owned.push_back(img.px);
+		image_view_t v = { img.w, img.h, owned.back().data() };
+		images.push_back(v);
+		return static_cast<unsigned>(images.size());
+	}
+
+	/* sampling is nearest, only the top level is ever used */
+	virtual unsigned load_texture_levels(const image_view_t* levels, int) override {
+		images.push_back(levels[0]);
+		return static_cast<unsigned>(images.size());
+	}
+
+	virtual void init_state() override {
+		fb_w = static_cast<int>(surface_w);
+		fb_h = static_cast<int>(surface_h);
+		fb.assign(fb_w * fb_h, 0);
+		clear_clip();
+	}
+
+	virtual void clear() override {
+		/* glClearColor is left at transparent black */
+		for (int j = clip_y0; j < clip_y1; j++)
+			std::fill_n(&fb[j * fb_w + clip_x0], clip_x1 - clip_x0, 0u);
+	}
+
+	virtual void set_clip(float x, float y, float w, float h) override {
+		clip_x0 = std::max(static_cast<int>(floorf(x)), 0);
+		clip_y0 = std::max(static_cast<int>(floorf(y)), 0);
+		clip_x1 = std::min(static_cast<int>(ceilf(x + w)), fb_w);
+		clip_y1 = std::min(static_cast<int>(ceilf(y + h)), fb_h);
+
+		/* nothing visible, keep the loops below from running backwards */
+		clip_x1 = std::max(clip_x1, clip_x0);
+		clip_y1 = std::max(clip_y1, clip_y0);
+	}
+
+	virtual void clear_clip() override {
+		clip_x0 = clip_y0 = 0;
+		clip_x1 = fb_w;
+		clip_y1 = fb_h;
+	}
+
+	virtual void bind_tex(unsigned tex) override {
+		cur_tex = tex;
+	}
+
+	virtual void fill_quad(float x, float y, float w, float h, bool textured, float r, float g, float b, bool blend) override {
+		int x0 = std::max(to_px(x), clip_x0), x1 = std::min(to_px(x + w), clip_x1);
+		int y0 = std::max(to_px(y), clip_y0), y1 = std::min(to_px(y + h), clip_y1);
+
+		if (x0 >= x1 || y0 >= y1)
+			return;
+
+		uint32_t color = px_from_float(r, g, b);
+		size_t n = x1 - x0;
+
+		/* untextured quads are opaque, blending them changes nothing */
+		if (!textured || !cur_tex || cur_tex > images.size()) {
+			for (int j = y0; j < y1; j++)
+				std::fill_n(&fb[j * fb_w + x0], n, color);
+			return;
+		}
+
+		const image_view_t& img = images[cur_tex - 1];
+
+		/* the sprite's u runs from 1 on the left to 0 on the right */
+		xmap.resize(n);
+		for (int i = x0; i < x1; i++) {
+			float u = 1 - (i + 0.5f - x) / w;
+			xmap[i - x0] = std::min(std::max(static_cast<int>(u * img.w), 0), img.w - 1);
+		}
+
+		span.resize(n);
+		bool tinted = color != px_rgba(255, 255, 255, 255);
+
+		for (int j = y0; j < y1; j++) {
+			float v = (j + 0.5f - y) / h;
+			int ty = std::min(std::max(static_cast<int>(v * img.h), 0), img.h - 1);
+			const uint32_t* row = &img.px[ty * img.w];
+
+			for (size_t i = 0; i < n; i++)
+				span[i] = row[xmap[i]];
+
+			if (tinted)
+				tint_span(span.data(), n, color);
+
+			uint32_t* dst = &fb[j * fb_w + x0];
+			if (blend)
+				blend_span(dst, span.data(), n);
+			else
+				std::copy(span.begin(), span.end(), dst);
+		}
+	}
+
+	virtual void draw_string(float x, float y, const char* s, float r, float g, float b) override {
+		uint32_t color = px_from_float(r, g, b);
+		int px = static_cast<int>(floorf(x));
+		int top = static_cast<int>(floorf(y)) + FONT_TOP;
+
+		for (; *s != '\0'; s++, px += FONT_W) {
+			const uint16_t* glyph = font9x15_glyph(*s);
+
+			for (int row = 0; row < FONT_CELL_H; row++) {
+				int fy = top + row;
+				if (fy < clip_y0 || fy >= clip_y1 || !glyph[row])
+					continue;
+
+				for (int col = 0; col < FONT_W; col++) {
+					int fx = px + col;
+					if ((glyph[row] & (0x8000 >> col)) && fx >= clip_x0 && fx < clip_x1)
+						fb[fy * fb_w + fx] = color;
+				}
+			}
+		}
+	}
+
+	const uint32_t* pixels() {
+		return fb.data();
+	}
+
+	int width() {
+		return fb_w;
+	}
+
+	int height() {
+		return fb_h;
+	}
+
+	/* binary PPM (P6), alpha dropped */
+	bool write_ppm(const char* path) {
+		FILE* f = fopen(path, "wb");
+		if (!f)
+			return false;
+
+		fprintf(f, "P6\n%d %d\n255\n", fb_w, fb_h);
+
+		std::vector<uint8_t> rgb(fb.size() * 3);
+		for (size_t i = 0; i < fb.size(); i++) {
+			rgb[i*3 + 0] = fb[i] & 0xff;
+			rgb[i*3 + 1] = (fb[i] >> 8) & 0xff;
+			rgb[i*3 + 2] = (fb[i] >> 16) & 0xff;
+		}
+
+		bool ok = fwrite(rgb.data(), 1, rgb.size(), f) == rgb.size();
+		return (fclose(f) == 0) && ok;
+	}
+
+	/* the framebuffer as is, width*height RGBA8 pixels, top row first */
+	bool write_raw(const char* path) {
+		FILE* f = fopen(path, "wb");
+		if (!f)
+			return false;
+
+		bool ok = fwrite(fb.data(), sizeof(uint32_t), fb.size(), f) == fb.size();
+		return (fclose(f) == 0) && ok;
+	}
+
+	soft_renderer_t() : cur_tex(0), fb_w(0), fb_h(0), clip_x0(0), clip_y0(0), clip_x1(0), clip_y1(0) {}
+};
+
+#endif /* INVADERS_SOFTRENDER_H */
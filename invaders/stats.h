@@ -0,0 +1,264 @@
+/*
+ * space invaders game - timing instrumentation
+ *
+ * fixed bucket latency histograms for tick and frame times plus a few
+ * counters, cheap enough to leave on all the time. front ends record
+ * into a stats_t and can have it dumped to a file every so often.
+ */
+
+#ifndef INVADERS_STATS_H
+#define INVADERS_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+/***************************************************************
+ * HISTOGRAM
+ ***************************************************************/
+
+/*
+ * log-linear histogram of nanosecond durations: 4 buckets per power of
+ * two, so any reported percentile is within 25% of the real value. no
+ * allocation, recording is a couple of instructions.
+ */
+#define HIST_SUB_BITS 2
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_SUB + (64 - HIST_SUB_BITS) * HIST_SUB)
+
+class histogram_t {
+	uint64_t buckets[HIST_BUCKETS];
+	uint64_t n, total, largest;
+
+	static int bucket_of(uint64_t v) {
+		if (v < HIST_SUB)
+			return static_cast<int>(v);
+
+		int msb = 63 - __builtin_clzll(v);
+		int sub = static_cast<int>((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+		return HIST_SUB + (msb - HIST_SUB_BITS) * HIST_SUB + sub;
+	}
+
+	/* largest value that lands in bucket b */
+	static uint64_t bucket_top(int b) {
+		if (b < HIST_SUB)
+			return b;
+
+		int shift = (b - HIST_SUB) / HIST_SUB;
+		uint64_t sub = (b - HIST_SUB) % HIST_SUB;
+		uint64_t lo = (HIST_SUB + sub) << shift;
+		return lo + (1ULL << shift) - 1;
+	}
+
+public:
+	void record(uint64_t ns) {
+		buckets[bucket_of(ns)]++;
+		n++;
+		total += ns;
+		largest = std::max(largest, ns);
+	}
+
+	/* p in [0, 1], e.g. 0.99. returns 0 if nothing was recorded */
+	uint64_t percentile(double p) {
+		if (!n)
+			return 0;
+
+		uint64_t want = static_cast<uint64_t>(p * n);
+		if (want >= n) want = n - 1;
+
+		uint64_t seen = 0;
+		for (int b = 0; b < HIST_BUCKETS; b++) {
+			seen += buckets[b];
+			if (seen > want)
+				return std::min(bucket_top(b), largest);
+		}
+		return largest;
+	}
+
+	uint64_t count() {
+		return n;
+	}
+
+	uint64_t max() {
+		return largest;
+	}
+
+	uint64_t mean() {
+		return n ? total / n : 0;
+	}
+
+	void reset() {
+		std::fill(buckets, buckets + HIST_BUCKETS, (uint64_t)0);
+		n = total = largest = 0;
+	}
+
+	histogram_t() {
+		reset();
+	}
+};
+
+/***************************************************************
+ * GAME STATS
+ ***************************************************************/
+
+typedef std::chrono::steady_clock stats_clock;
+
+inline uint64_t stats_ns(stats_clock::duration d) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+/*
+ * everything we measure about a running game. histograms and counters
+ * cover the whole run, the rates are worked out over the last window
+ * (see roll_window()).
+ */
+class stats_t {
+	/* rate window */
+	stats_clock::time_point window_start;
+	uint64_t window_ticks, window_frames;
+
+	/* autosave writes finish on the writer thread */
+	std::mutex bg_lock;
+
+	/* periodic dump */
+	FILE* dump_file;
+	double dump_every_ms;
+	stats_clock::time_point last_dump;
+
+public:
+	histogram_t tick_ns, frame_ns;
+
+	uint64_t ticks, frames;
+
+	/* wakeups where no tick changed anything so nothing was redrawn */
+	uint64_t skipped_redraws;
+
+	/* state changes and draw calls sent to / kept from GL, summed over frames */
+	uint64_t gl_issued, gl_elided;
+
+	/* rates over the last complete window */
+	double ticks_per_sec, frames_per_sec;
+
+	/*
+	 * autosaves: capture is the part on the tick thread, over_budget
+	 * counts captures that made their tick take longer than a tick.
+	 * writes (snapshot + disk) happen in the background.
+	 */
+	histogram_t autosave_capture_ns, autosave_write_ns;
+	uint64_t autosaves, autosave_over_budget, autosave_failed;
+
+	void on_tick(uint64_t ns) {
+		tick_ns.record(ns);
+		ticks++;
+		window_ticks++;
+	}
+
+	void on_frame(uint64_t ns) {
+		frame_ns.record(ns);
+		frames++;
+		window_frames++;
+	}
+
+	void on_gl_calls(unsigned long issued, unsigned long elided) {
+		gl_issued += issued;
+		gl_elided += elided;
+	}
+
+	void on_skipped_redraw() {
+		skipped_redraws++;
+	}
+
+	void on_autosave_capture(uint64_t ns, bool over_budget) {
+		autosave_capture_ns.record(ns);
+		autosaves++;
+		if (over_budget)
+			autosave_over_budget++;
+	}
+
+	/* safe to call from any thread */
+	void on_autosave_write(uint64_t ns, bool ok) {
+		std::lock_guard<std::mutex> l(bg_lock);
+		autosave_write_ns.record(ns);
+		if (!ok)
+			autosave_failed++;
+	}
+
+	/* recompute the rates once a second worth of data is in */
+	void roll_window(stats_clock::time_point t) {
+		double ms = std::chrono::duration<double, std::milli>(t - window_start).count();
+
+		if (ms < 1000)
+			return;
+
+		ticks_per_sec = window_ticks * 1000.0 / ms;
+		frames_per_sec = window_frames * 1000.0 / ms;
+		window_ticks = window_frames = 0;
+		window_start = t;
+	}
+
+	/* one line summary, times in microseconds */
+	void print(FILE* f) {
+		fprintf(f, "ticks %llu (%.0f/s) tick p50 %.1fus p99 %.1fus max %.1fus | "
+				"frames %llu (%.1f/s) frame p50 %.1fus p99 %.1fus max %.1fus | "
+				"gl calls/frame %.1f issued %.1f elided | skipped redraws %llu\n",
+				(unsigned long long)ticks, ticks_per_sec,
+				tick_ns.percentile(0.5) / 1000.0, tick_ns.percentile(0.99) / 1000.0, tick_ns.max() / 1000.0,
+				(unsigned long long)frames, frames_per_sec,
+				frame_ns.percentile(0.5) / 1000.0, frame_ns.percentile(0.99) / 1000.0, frame_ns.max() / 1000.0,
+				frames ? (double)gl_issued / frames : 0.0, frames ? (double)gl_elided / frames : 0.0,
+				(unsigned long long)skipped_redraws);
+
+		if (!autosaves)
+			return;
+
+		std::lock_guard<std::mutex> l(bg_lock);
+		fprintf(f, "autosaves %llu capture p50 %.1fus p99 %.1fus max %.1fus over budget %llu | "
+				"write p50 %.1fus max %.1fus failed %llu\n",
+				(unsigned long long)autosaves,
+				autosave_capture_ns.percentile(0.5) / 1000.0, autosave_capture_ns.percentile(0.99) / 1000.0,
+				autosave_capture_ns.max() / 1000.0, (unsigned long long)autosave_over_budget,
+				autosave_write_ns.percentile(0.5) / 1000.0, autosave_write_ns.max() / 1000.0,
+				(unsigned long long)autosave_failed);
+	}
+
+	/* append a summary line to `path` every `every_ms` (see maybe_dump) */
+	bool set_dump(const char* path, double every_ms) {
+		if (dump_file)
+			fclose(dump_file);
+
+		dump_file = fopen(path, "a");
+		dump_every_ms = every_ms;
+		last_dump = stats_clock::now();
+		return dump_file != NULL;
+	}
+
+	/* call this regularly, it's a no-op unless a dump is due */
+	void maybe_dump(stats_clock::time_point t) {
+		roll_window(t);
+
+		if (!dump_file)
+			return;
+
+		if (std::chrono::duration<double, std::milli>(t - last_dump).count() < dump_every_ms)
+			return;
+
+		print(dump_file);
+		fflush(dump_file);
+		last_dump = t;
+	}
+
+	stats_t() : window_ticks(0), window_frames(0), dump_file(NULL), dump_every_ms(0),
+				ticks(0), frames(0), skipped_redraws(0), gl_issued(0), gl_elided(0), ticks_per_sec(0), frames_per_sec(0),
+				autosaves(0), autosave_over_budget(0), autosave_failed(0) {
+		window_start = last_dump = stats_clock::now();
+	}
+
+	~stats_t() {
+		if (dump_file)
+			fclose(dump_file);
+	}
+};
+
+#endif /* INVADERS_STATS_H */
@@ -0,0 +1,188 @@
+/*
+ * space invaders game - background file writer
+ *
+ * saving shouldn't hold up the game, so the game hands finished buffers
+ * to a writer thread and carries on. every file is replaced atomically
+ * (temp file, fsync, rename), a crash in the middle of a save leaves the
+ * previous file as it was.
+ */
+
+#ifndef INVADERS_WRITER_H
+#define INVADERS_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if __WINDOWS__
+#error add win32 support
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#endif
+
+/*
+ * replace path with data: write it next to it, get it onto the disk,
+ * rename it over path and get the rename onto the disk too. readers
+ * see either the old file or the new one, never a mix.
+ */
+inline bool write_file_atomic(const char* path, const uint8_t* data, size_t n) {
+	std::string tmp = std::string(path) + ".tmp";
+
+	int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+
+	bool ok = ::write(fd, data, n) == (ssize_t)n;
+	ok = ok && fsync(fd) == 0;
+	ok = (::close(fd) == 0) && ok;
+
+	if (!ok || rename(tmp.c_str(), path) != 0) {
+		unlink(tmp.c_str());
+		return false;
+	}
+
+	/* the rename lives in the directory */
+	std::string dir_buf(path);
+	int dfd = ::open(dirname(&dir_buf[0]), O_RDONLY);
+	if (dfd >= 0) {
+		fsync(dfd);
+		::close(dfd);
+	}
+
+	return true;
+}
+
+/*
+ * one thread working through a queue of whole-file writes. a file that
+ * is queued again before its turn only gets written once, with the
+ * newest data. the data can also be made on the writer thread, so the
+ * caller only pays for grabbing what's needed to make it.
+ */
+class file_writer_t {
+public:
+	/* fills in the file's contents, on the writer thread */
+	typedef std::function<void(std::vector<uint8_t>&)> make_fn;
+
+	/* told how it went and how long making + writing took, on the writer thread */
+	typedef std::function<void(bool ok, uint64_t ns)> done_fn;
+
+private:
+	struct job_t {
+		std::string path;
+		std::vector<uint8_t> data;
+		make_fn make;
+		done_fn done;
+	};
+
+	std::mutex m;
+	std::condition_variable work_cv, idle_cv;
+	std::deque<job_t> queue;
+
+	/* a job is off the queue and being written */
+	bool busy;
+	bool quit;
+
+	std::thread thread;
+
+	void push(job_t&& job) {
+		{
+			std::lock_guard<std::mutex> l(m);
+
+			for (auto& j : queue) {
+				if (j.path == job.path) {
+					j = std::move(job);
+					return;
+				}
+			}
+
+			queue.push_back(std::move(job));
+		}
+		work_cv.notify_one();
+	}
+
+	void run() {
+		std::unique_lock<std::mutex> l(m);
+
+		for (;;) {
+			work_cv.wait(l, [&] { return quit || !queue.empty(); });
+
+			if (queue.empty())
+				return;
+
+			job_t job = std::move(queue.front());
+			queue.pop_front();
+			busy = true;
+
+			l.unlock();
+
+			auto t0 = std::chrono::steady_clock::now();
+
+			if (job.make)
+				job.make(job.data);
+
+			bool ok = write_file_atomic(job.path.c_str(), job.data.data(), job.data.size());
+			if (!ok)
+				perror(job.path.c_str());
+
+			if (job.done)
+				job.done(ok, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+
+			l.lock();
+
+			busy = false;
+			if (ok) written++;
+			else failed++;
+
+			if (queue.empty())
+				idle_cv.notify_all();
+		}
+	}
+
+public:
+	/* files written and writes that failed, for the curious */
+	std::atomic<unsigned long> written, failed;
+
+	/* queue data to replace path, takes the buffer over */
+	void submit(const char* path, std::vector<uint8_t>&& data) {
+		job_t j = { path, std::move(data), make_fn(), done_fn() };
+		push(std::move(j));
+	}
+
+	/* same but the data is made by make() when it's path's turn */
+	void submit(const char* path, make_fn make, done_fn done = done_fn()) {
+		job_t j = { path, std::vector<uint8_t>(), std::move(make), std::move(done) };
+		push(std::move(j));
+	}
+
+	/* wait until everything queued so far is on disk */
+	void drain() {
+		std::unique_lock<std::mutex> l(m);
+		idle_cv.wait(l, [&] { return queue.empty() && !busy; });
+	}
+
+	file_writer_t() : busy(false), quit(false), written(0), failed(0) {
+		thread = std::thread(&file_writer_t::run, this);
+	}
+
+	/* whatever is still queued gets written first */
+	~file_writer_t() {
+		{
+			std::lock_guard<std::mutex> l(m);
+			quit = true;
+		}
+		work_cv.notify_one();
+		thread.join();
+	}
+};
+
+#endif /* INVADERS_WRITER_H */